@@ -0,0 +1,99 @@
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <madm_comm.h>
+#include <madm_debug.h>
+
+using namespace std;
+using namespace madi;
+
+// measures the latency of get on regions registered with reg_coll_mmap
+// and accessed without their ids, which translates the address by
+// searching the registered regions (MPI-3 layer).
+
+static void real_main(int argc, char **argv)
+{
+    int me = comm::get_pid();
+    int n_procs = comm::get_n_procs();
+
+#if MADI_COMM_LAYER != MADI_COMM_LAYER_MPI3
+    if (me == 0)
+        fprintf(stderr, "This program only supports the MPI-3 layer.\n");
+    return;
+#endif
+
+    int argidx = 1;
+    int n_regions = (argc >= argidx + 1) ? atoi(argv[argidx++]) : 200;
+    int n_msgs    = (argc >= argidx + 1) ? atoi(argv[argidx++]) : 10000;
+
+    if (n_procs < 2) {
+        if (me == 0)
+            fprintf(stderr, "This program needs two or more processes.\n");
+        return;
+    }
+
+    if (me == 0) {
+        printf("n_regions = %d, n_msgs = %d\n", n_regions, n_msgs);
+        fflush(stdout);
+    }
+
+    size_t region_size = 8192;
+    uint8_t *base = (uint8_t *)0x40000000000;
+
+    // regions are spaced apart so that they do not coalesce
+    vector<int> ids(n_regions);
+    for (int i = 0; i < n_regions; i++) {
+        uint8_t *addr = base + 2 * region_size * i;
+
+        ids[i] = comm::reg_coll_mmap(addr, region_size);
+        memset(addr, i, region_size);
+    }
+
+    comm::barrier();
+
+    if (me == 0) {
+        int target = 1;
+        uint64_t value = 0;
+
+        srand(12345);
+
+        vector<int> order(n_msgs);
+        for (int i = 0; i < n_msgs; i++)
+            order[i] = rand() % n_regions;
+
+        // the same regions through their ids, which need no search
+        tsc_t t0 = rdtsc();
+
+        for (int i = 0; i < n_msgs; i++) {
+            uint8_t *addr = base + 2 * region_size * order[i];
+            comm::reg_get(ids[order[i]], &value, addr, sizeof(value), target);
+        }
+
+        tsc_t t1 = rdtsc();
+
+        for (int i = 0; i < n_msgs; i++) {
+            uint8_t *addr = base + 2 * region_size * order[i];
+            comm::get(&value, addr, sizeof(value), target);
+        }
+
+        tsc_t t2 = rdtsc();
+
+        printf("reg_get = %9.1f clocks/msg, get = %9.1f clocks/msg\n",
+               (double)(t1 - t0) / n_msgs, (double)(t2 - t1) / n_msgs);
+    }
+
+    comm::barrier();
+
+    for (int i = n_regions - 1; i >= 0; i--)
+        comm::reg_coll_munmap(ids[i]);
+}
+
+int main(int argc, char **argv)
+{
+    comm::initialize(argc, argv);
+
+    comm::start(real_main, argc, argv);
+
+    comm::finalize();
+    return 0;
+}
@@ -4,21 +4,93 @@
 #include <memory>
 #include <vector>
 #include <cstdint>
+#include <cstdio>
 
 namespace madi {
 namespace comm {
 
     struct alc_header {
-        alc_header *next;
-        uintptr_t size;
+        union {
+            alc_header *next;       // next block in a free list
+            uintptr_t requested;    // requested bytes of an allocated block
+        };
+        uintptr_t size;             // # of units of a large block, or
+                                    // small_block_bit | size class
+    };
+
+    struct allocator_stats {
+        size_t heap_bytes;          // bytes obtained with extend_to
+        size_t n_slabs;
+        size_t slab_bytes;          // bytes of slabs for small blocks
+        size_t small_bytes;         // class bytes of allocated small blocks
+        size_t small_requested;     // requested bytes of them
+        size_t large_bytes;         // bytes of allocated large blocks
+        size_t large_requested;     // requested bytes of them
+        size_t free_bytes;          // bytes in the large free list
+        size_t n_free_blocks;
+        size_t largest_free_bytes;
+    };
+
+    // memory region of a fixed capacity carved out of another region.
+    // an allocator on it never extends the underlying region, so it needs
+    // no synchronization with other processes; it runs out of memory
+    // instead.
+    class fixed_region {
+        uint8_t *base_;
+        size_t capacity_;
+        size_t size_;
+
+    public:
+        fixed_region(void *base, size_t capacity)
+            : base_((uint8_t *)base), capacity_(capacity), size_(0)
+        {
+        }
+
+        size_t size() const { return size_; }
+        size_t capacity() const { return capacity_; }
+        uint8_t * base() const { return base_; }
+
+        template <class T>
+        void * extend_to(size_t size, T&)
+        {
+            if (size_ >= capacity_)
+                return NULL;
+
+            uint8_t *p = base_ + size_;
+            size_ = (size < capacity_) ? size : capacity_;
+            return p;
+        }
     };
 
+    // segregated-fit allocator.
+    //
+    // blocks of up to max_small_size bytes are rounded up to a size class
+    // and taken from the free list of the class in O(1). an empty class
+    // is refilled by carving a slab, which is a large block, into blocks
+    // of the class. small blocks are not coalesced and slabs are never
+    // returned. larger blocks are allocated first-fit from an address
+    // ordered free list (K&R malloc), which coalesces adjacent free
+    // blocks and extends the memory region when no block fits.
     template <class MemRegion>
     class allocator {
+        enum {
+            n_linear_classes = 8,       // 16, 32, ..., 128 bytes
+            n_sub_classes = 4,          // per doubling above 128 bytes
+            n_classes = n_linear_classes + 5 * n_sub_classes,
+            min_slab_size = 16 * 1024,
+            min_slab_blocks = 8,
+        };
+
+        static const size_t max_small_size = 4096;
+        static const uintptr_t small_block_bit = (uintptr_t)1 << 63;
+
         alc_header *free_list_;
         MemRegion *mr_;
         alc_header *header_;
 
+        alc_header *small_free_[n_classes];
+        allocator_stats stats_;
+
     public:
         allocator(MemRegion *mr);
         ~allocator();
@@ -27,6 +99,9 @@ namespace comm {
         void * allocate(size_t size, T& param);
         void deallocate(void *p);
 
+        allocator_stats stats();
+        void print_stats(FILE *fp, const char *name, int pid);
+
         // custom deleter for allocator<T>::unique_ptr
         template <class T>
         class default_delete {
@@ -71,17 +146,31 @@ namespace comm {
 
             return unique_ptr<T>(obj, default_delete<T>(this));
         }
+
+    private:
+        static int size_class(size_t size);
+        static size_t class_size(int c);
+
+        template <class T>
+        bool refill(int c, T& param);
+
+        template <class T>
+        void * allocate_large(size_t size, T& param);
+        void deallocate_large(alc_header *header);
     };
 
 
     template <class MR>
-    allocator<MR>::allocator(MR *mr) : free_list_(NULL), mr_(mr)
+    allocator<MR>::allocator(MR *mr) : free_list_(NULL), mr_(mr), stats_()
     {
         header_ = new alc_header;
         header_->next = header_;
         header_->size = 0;
 
         free_list_ = header_;
+
+        for (int c = 0; c < n_classes; c++)
+            small_free_[c] = NULL;
     }
 
     template <class MR>
@@ -89,7 +178,177 @@ namespace comm {
     {
         delete header_;
     }
-#if 1
+
+    template <class MR>
+    int allocator<MR>::size_class(size_t size)
+    {
+        if (size <= 16 * n_linear_classes)
+            return (size == 0) ? 0 : (int)((size - 1) / 16);
+
+        // n_sub_classes classes in (2^e, 2^(e+1)]
+        int e = 63 - __builtin_clzl(size - 1);
+        size_t base = (size_t)1 << e;
+        size_t step = base / n_sub_classes;
+        size_t sub = (size - base + step - 1) / step - 1;
+
+        return n_linear_classes + (e - 7) * n_sub_classes + (int)sub;
+    }
+
+    template <class MR>
+    size_t allocator<MR>::class_size(int c)
+    {
+        if (c < n_linear_classes)
+            return 16 * (c + 1);
+
+        int k = c - n_linear_classes;
+        size_t base = (size_t)1 << (7 + k / n_sub_classes);
+        size_t step = base / n_sub_classes;
+
+        return base + (k % n_sub_classes + 1) * step;
+    }
+
+    template <class MR>
+    template <class T>
+    void * allocator<MR>::allocate(size_t size, T& param)
+    {
+        if (size > max_small_size) {
+            void *p = allocate_large(size, param);
+
+            if (p != NULL) {
+                alc_header *h = (alc_header *)p - 1;
+                h->requested = size;
+
+                stats_.large_bytes += h->size * sizeof(alc_header);
+                stats_.large_requested += size;
+            }
+            return p;
+        }
+
+        int c = size_class(size);
+
+        if (small_free_[c] == NULL && !refill(c, param))
+            return NULL;
+
+        alc_header *h = small_free_[c];
+        small_free_[c] = h->next;
+        h->requested = size;
+
+        stats_.small_bytes += class_size(c);
+        stats_.small_requested += size;
+
+        return (void *)(h + 1);
+    }
+
+    template <class MR>
+    void allocator<MR>::deallocate(void *p)
+    {
+        if (p == NULL)
+            return;
+
+        alc_header *h = (alc_header *)p - 1;
+
+        if (h->size & small_block_bit) {
+            int c = (int)(h->size & ~small_block_bit);
+
+            MADI_ASSERT(0 <= c && c < n_classes);
+
+            stats_.small_bytes -= class_size(c);
+            stats_.small_requested -= h->requested;
+
+            h->next = small_free_[c];
+            small_free_[c] = h;
+        } else {
+            stats_.large_bytes -= h->size * sizeof(alc_header);
+            stats_.large_requested -= h->requested;
+
+            deallocate_large(h);
+        }
+    }
+
+    template <class MR>
+    template <class T>
+    bool allocator<MR>::refill(int c, T& param)
+    {
+        size_t stride = sizeof(alc_header) + class_size(c);
+        size_t slab_size = min_slab_blocks * stride;
+        if (slab_size < min_slab_size)
+            slab_size = min_slab_size;
+
+        uint8_t *slab = (uint8_t *)allocate_large(slab_size, param);
+
+        if (slab == NULL)
+            return false;
+
+        // link the blocks in address order
+        size_t n_blocks = slab_size / stride;
+        alc_header *next = NULL;
+        for (size_t i = n_blocks; i > 0; i--) {
+            alc_header *h = (alc_header *)(slab + (i - 1) * stride);
+            h->next = next;
+            h->size = small_block_bit | (uintptr_t)c;
+            next = h;
+        }
+
+        small_free_[c] = next;
+
+        stats_.n_slabs += 1;
+        stats_.slab_bytes += slab_size;
+
+        return true;
+    }
+
+    template <class MR>
+    allocator_stats allocator<MR>::stats()
+    {
+        allocator_stats st = stats_;
+        st.heap_bytes = mr_->size();
+        st.free_bytes = 0;
+        st.n_free_blocks = 0;
+        st.largest_free_bytes = 0;
+
+        alc_header *h = header_->next;
+        while (h != header_) {
+            size_t bytes = h->size * sizeof(alc_header);
+
+            st.free_bytes += bytes;
+            st.n_free_blocks += 1;
+            if (bytes > st.largest_free_bytes)
+                st.largest_free_bytes = bytes;
+
+            h = h->next;
+        }
+
+        return st;
+    }
+
+    template <class MR>
+    void allocator<MR>::print_stats(FILE *fp, const char *name, int pid)
+    {
+        allocator_stats st = stats();
+
+        // internal: bytes lost to rounding up to classes and units,
+        // external: free bytes that cannot serve the largest request
+        size_t used = st.small_bytes + st.large_bytes;
+        size_t requested = st.small_requested + st.large_requested;
+        double internal = (used == 0) ? 0.0 :
+            100.0 * (double)(used - requested) / (double)used;
+        double external = (st.free_bytes == 0) ? 0.0 :
+            100.0 * (double)(st.free_bytes - st.largest_free_bytes)
+                  / (double)st.free_bytes;
+
+        fprintf(fp,
+                "MADM_ALLOC_STATS: %s, pid = %d, heap = %zu, "
+                "small = %zu/%zu in %zu slabs (%zu bytes), "
+                "large = %zu/%zu, "
+                "free = %zu in %zu blocks (largest = %zu), "
+                "internal frag = %.1f%%, external frag = %.1f%%\n",
+                name, pid, st.heap_bytes,
+                st.small_requested, st.small_bytes,
+                st.n_slabs, st.slab_bytes,
+                st.large_requested, st.large_bytes,
+                st.free_bytes, st.n_free_blocks, st.largest_free_bytes,
+                internal, external);
+    }
 
 #define MADI_ALC_ASSERT(h) \
     do { \
@@ -100,7 +359,7 @@ namespace comm {
     // K&R malloc
     template <class MR>
     template <class T>
-    void * allocator<MR>::allocate(size_t size, T& param)
+    void * allocator<MR>::allocate_large(size_t size, T& param)
     {
         const size_t init_size = 2 * 1024 * 1024;
 
@@ -113,7 +372,8 @@ namespace comm {
             if (h->size >= n_units)
                 break;
 
-            if (prev == free_list_) {
+            if (h == free_list_) {
+                // wrapped around the free list
                 size_t prev_size = mr_->size();
                 size_t total_size = (prev_size == 0) ? init_size : prev_size*2;
 
@@ -131,10 +391,12 @@ namespace comm {
                 new_header->next = NULL;
                 new_header->size = new_n_units;
 
-                deallocate((void *)(new_header + 1));
+                deallocate_large(new_header);
 
-                // retry this loop
-                prev = free_list_;
+                // retry this loop from the block before the new one.
+                // h may have been merged into the new block, so it is
+                // not a valid free block anymore.
+                h = free_list_;
             }
            
             prev = h;
@@ -157,10 +419,8 @@ namespace comm {
     }
 
     template <class MR>
-    void allocator<MR>::deallocate(void *p)
+    void allocator<MR>::deallocate_large(alc_header *header)
     {
-        alc_header *header = (alc_header *)p - 1;
-
         alc_header *h = free_list_;
         for (;;) {
             if (h < header && header < h->next)
@@ -188,106 +448,5 @@ namespace comm {
 
         free_list_ = h;
     }
-#else
-    template <class MR>
-    void * allocator<MR>::allocate(size_t size)
-    {
-        if (size == 0)
-            return NULL;
-
-        size_t actual_size = sizeof(alc_header) + size;
-
-        alc_header *end_header = free_list_;
-        alc_header *prev_header = free_list_;
-
-        MADI_ASSERT(prev_header->next != NULL);
-
-        alc_header *header = prev_header->next;
-
-        while (header != end_header) {
-            MADI_ASSERT(header != NULL);
-            MADI_ASSERT(header->next != NULL);
-
-            if (header->size >= actual_size)
-                break;
-
-            prev_header = header;
-            header = header->next;
-        }
-
-        if (header == end_header) {
-            // extend
-            size_t prev_size = mr_->size();
-            size_t total_size = mr_->size() * 2;
-            header = (alc_header *)mr_->extend_to(total_size);
-
-            MADI_CHECK(header != NULL);
-
-            header->next = end_header;
-            header->size = mr_->size() - prev_size - sizeof(header);
-        }
-
-        if (header->size == size) {
-            prev_header->next = header->next;
-            free_list_ = header->next;
-        } else {
-            alc_header *new_header =
-                (alc_header *)((uint8_t *)header + actual_size);
-
-            new_header->next = header->next;
-            new_header->size = header->size - actual_size;
-
-            header->size = size;
-            prev_header->next = new_header;
-            free_list_ = new_header;
-        }
-
-        header->next = NULL;
-        return (void *)(header + 1);
-    }
-
-    inline alc_header *try_merge(alc_header * h0, alc_header * h1)
-    {
-        uint8_t *h0_end = (uint8_t *)(h0 + 1) + h0->size;
-
-        if (h0_end == (uint8_t *)h1) {
-            h0->next = h1->next;
-            h0->size += sizeof(*h1) + h1->size;
-            return h0;
-        } else {
-            return h1;
-        }
-    }
-
-    template <class MR>
-    void allocator<MR>::deallocate(void *p)
-    {
-        if (p == NULL)
-            return;
-
-        alc_header *h = (alc_header *)p - 1;
-
-        alc_header *end_header = free_list_;
-        alc_header *prev_header = free_list_;
-        alc_header *header = prev_header->next;
-
-        while (header != end_header) {
-            MADI_ASSERT(header != NULL);
-            MADI_ASSERT(header->next != NULL);
-
-            if (h < header)
-                break;
-
-            prev_header = header;
-            header = header->next;
-        }
-
-        prev_header->next = h;
-        h->next = header;
-
-        alc_header *new_header = try_merge(prev_header, h);
-        try_merge(new_header, header);
-    }
-#endif
 }
 }
@@ -17,6 +17,10 @@ namespace comm {
         AM_FETCH_AND_ADD_INT_REP,
         AM_FETCH_AND_ADD_LONG_REQ,
         AM_FETCH_AND_ADD_LONG_REP,
+        AM_COMPARE_AND_SWAP_INT_REQ,
+        AM_COMPARE_AND_SWAP_INT_REP,
+        AM_COMPARE_AND_SWAP_LONG_REQ,
+        AM_COMPARE_AND_SWAP_LONG_REP,
     };
 
     struct aminfo {
@@ -193,6 +197,10 @@ namespace comm {
         template <class T>
         T fetch_and_add(T *dst, T value, int target, process_config& config);
 
+        template <class T>
+        bool compare_and_swap(T *dst, T old_v, T new_v, int target,
+                              process_config& config);
+
     private:
         bool is_server(int pid);
         int server_pid(size_t pid);
@@ -91,19 +91,28 @@ namespace comm {
         void coll_munmap(int memid)
         { c_.coll_munmap(memid, *config_); }
 
-        void put_nbi(void *dst, void *src, size_t size, int target)
-        { c_.put_nbi(dst, src, size, target, *config_); }
+        rma_handle put_nbi(void *dst, void *src, size_t size, int target)
+        { return c_.put_nbi(dst, src, size, target, *config_); }
 
-        void reg_put_nbi(int memid, void *dst, void *src, size_t size,
-                         int target)
-        { c_.reg_put_nbi(memid, dst, src, size, target, *config_); }
+        rma_handle reg_put_nbi(int memid, void *dst, void *src, size_t size,
+                               int target)
+        { return c_.reg_put_nbi(memid, dst, src, size, target, *config_); }
 
-        void get_nbi(void *dst, void *src, size_t size, int target)
-        { c_.get_nbi(dst, src, size, target, *config_); }
+        rma_handle get_nbi(void *dst, void *src, size_t size, int target)
+        { return c_.get_nbi(dst, src, size, target, *config_); }
 
-        void reg_get_nbi(int memid, void *dst, void *src, size_t size,
-                         int target)
-        { c_.reg_get_nbi(memid, dst, src, size, target, *config_); }
+        rma_handle reg_get_nbi(int memid, void *dst, void *src, size_t size,
+                               int target)
+        { return c_.reg_get_nbi(memid, dst, src, size, target, *config_); }
+
+        bool test(const rma_handle& h)
+        { return c_.test(h); }
+
+        void wait(const rma_handle& h)
+        { c_.wait(h); }
+
+        void wait_all(const rma_handle hs[], size_t n)
+        { c_.wait_all(hs, n); }
 
         int poll(int *tag_out, int *pid_out)
         { return c_.poll(tag_out, pid_out, *config_); }
@@ -115,10 +124,10 @@ namespace comm {
         { c_.native_barrier(*config_); }
 
         void put(void *dst, void *src, size_t size, int target)
-        { put_nbi(dst, src, size, target); fence(); }
+        { wait(put_nbi(dst, src, size, target)); }
 
         void get(void *dst, void *src, size_t size, int target)
-        { get_nbi(dst, src, size, target); fence(); }
+        { wait(get_nbi(dst, src, size, target)); }
 
         template <class T>
         void put_value(T *dst, T value, int target)
@@ -132,6 +141,10 @@ namespace comm {
         T fetch_and_add(T *dst, T value, int target)
         { return c_.fetch_and_add(dst, value, target, *config_); }
 
+        template <class T>
+        bool compare_and_swap(T *dst, T old_v, T new_v, int target)
+        { return c_.compare_and_swap(dst, old_v, new_v, target, *config_); }
+
         void request(int tag, void *p, size_t size, int pid)
         { c_.request(tag, p, size, pid, *config_); }
 
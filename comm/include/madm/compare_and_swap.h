@@ -0,0 +1,120 @@
+#ifndef MADI_COMM_COMPARE_AND_SWAP_H
+#define MADI_COMM_COMPARE_AND_SWAP_H
+
+#include "madm_comm-decls.h"
+#include "ampeer.h"
+#include "threadsafe.h"
+
+namespace madi {
+namespace comm {
+
+    class compare_and_swap_sync {
+        bool done_;
+        bool result_;
+
+    public:
+        compare_and_swap_sync() : done_(false), result_(false) {}
+
+        void fill(bool result)
+        {
+            MADI_DPUTSR3("AM_COMPARE_AND_SWAP FILL: sync=%p,done=%d,res=%d",
+                         this, (int)done_, (int)result_);
+
+            result_ = result;
+            threadsafe::wbarrier();
+            done_ = true;
+        }
+
+        bool try_get(bool *result)
+        {
+            if (!done_)
+                return false;
+
+            threadsafe::rbarrier();
+
+            MADI_DPUTSR3("AM_COMPARE_AND_SWAP DONE: sync=%p,done=%d,res=%d",
+                         this, (int)done_, (int)result_);
+
+            *result = result_;
+            return true;
+        }
+    };
+
+    class compare_and_swap_rep {
+    public:
+        bool result_;
+        compare_and_swap_sync *sync_;
+
+    public:
+        compare_and_swap_rep(bool result, compare_and_swap_sync *sync) :
+            result_(result), sync_(sync) {}
+
+        static void amhandle(void *data, size_t, int pid, aminfo *)
+        {
+            const compare_and_swap_rep& rep = *(compare_and_swap_rep *)data;
+
+            MADI_DPUTSR3("AM_COMPARE_AND_SWAP REP: sync=%p,res=%d,pid=%d",
+                         rep.sync_, (int)rep.result_, pid);
+
+            rep.sync_->fill(rep.result_);
+
+            MADI_DPUTSR3("AM_COMPARE_AND_SWAP REP: DONE");
+        }
+    };
+
+    template <class T>
+    class compare_and_swap_req {
+
+        struct packet {
+            T *p;
+            T old_v;
+            T new_v;
+            compare_and_swap_sync *sync_ptr;
+
+            packet(T *ptr, T ov, T nv, compare_and_swap_sync *sp) :
+                p(ptr), old_v(ov), new_v(nv), sync_ptr(sp) {}
+        };
+
+        compare_and_swap_sync sync_;
+        packet packet_;
+
+    public:
+        compare_and_swap_req(T *p, T old_v, T new_v) :
+            sync_(), packet_(p, old_v, new_v, &sync_) {}
+
+        void request(int tag, int target)
+        {
+            MADI_DPUTSR3("AM_COMPARE_AND_SWAP START: sync=%p", &sync_);
+
+            amrequest(tag, &packet_, sizeof(packet_), target);
+        }
+
+        bool test(bool *result)
+        {
+            return sync_.try_get(result);
+        }
+
+        static void amhandle(void *data, size_t, int pid, aminfo *info,
+                             int rep_tag)
+        {
+            const packet& req = *(packet *)data;
+
+            MADI_DPUTSR3("AM_COMPARE_AND_SWAP REQ: p=%p,old=%ld,new=%ld,pid=%d",
+                         req.p, (long)req.old_v, (long)req.new_v, pid);
+
+            // the target process may update the word with local atomics
+            bool result =
+                threadsafe::compare_and_swap(req.p, req.old_v, req.new_v);
+
+            compare_and_swap_rep rep(result, req.sync_ptr);
+
+            amreply(rep_tag, &rep, sizeof(rep), info);
+
+            MADI_DPUTSR3("AM_COMPARE_AND_SWAP REQ: DONE");
+        }
+    };
+
+}
+}
+
+#endif
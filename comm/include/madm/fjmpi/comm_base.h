@@ -5,6 +5,7 @@
 #include "../ampeer.h"
 #include "../process_config.h"
 #include "../allocator.h"
+#include "../rma_handle.h"
 #include "madm_misc.h"
 #include "madm_debug.h"
 
@@ -53,14 +54,14 @@ namespace comm {
         void free(void *p, process_config& config);
         int  coll_mmap(uint8_t *addr, size_t size, process_config& config);
         void coll_munmap(int memid, process_config& config);
-        void put_nbi(void *dst, void *src, size_t size, int target,
-                     process_config& config);
-        void reg_put_nbi(int memid, void *dst, void *src, size_t size,
-                         int target, process_config& config);
-        void get_nbi(void *dst, void *src, size_t size, int target,
-                     process_config& config);
-        void reg_get_nbi(int memid, void *dst, void *src, size_t size,
-                         int target, process_config& config);
+        rma_handle put_nbi(void *dst, void *src, size_t size, int target,
+                           process_config& config);
+        rma_handle reg_put_nbi(int memid, void *dst, void *src, size_t size,
+                               int target, process_config& config);
+        rma_handle get_nbi(void *dst, void *src, size_t size, int target,
+                           process_config& config);
+        rma_handle reg_get_nbi(int memid, void *dst, void *src, size_t size,
+                               int target, process_config& config);
         void raw_put(int tag, void *dst, void *src, size_t size, int target,
                      int me);
         void raw_put_ordered(int tag, void *dst, void *src, size_t size,
@@ -108,6 +109,13 @@ namespace comm {
 
         void fence();
         int  poll(int *tag_out, int *pid_out, process_config& config);
+
+        // FJMPI completes operations only all together
+        bool test(const rma_handle& h) { wait(h); return true; }
+        void wait(const rma_handle& h) { if (h.win != -1) fence(); }
+        void wait_all(const rma_handle [], size_t) { fence(); }
+
+        // compare_and_swap is an active message (see ampeer)
     };
 
 }
@@ -5,6 +5,7 @@
 #include "../ampeer.h"
 #include "../process_config.h"
 #include "../allocator.h"
+#include "../rma_handle.h"
 #include "madm_misc.h"
 #include "madm_debug.h"
 
@@ -48,14 +49,14 @@ namespace comm {
         void free(void *p, process_config& config);
         int  coll_mmap(uint8_t *addr, size_t size, process_config& config);
         void coll_munmap(int memid, process_config& config);
-        void put_nbi(void *dst, void *src, size_t size, int target,
-                     process_config& config);
-        void reg_put_nbi(int memid, void *dst, void *src, size_t size,
-                         int target, process_config& config);
-        void get_nbi(void *dst, void *src, size_t size, int target,
-                     process_config& config);
-        void reg_get_nbi(int memid, void *dst, void *src, size_t size,
-                         int target, process_config& config);
+        rma_handle put_nbi(void *dst, void *src, size_t size, int target,
+                           process_config& config);
+        rma_handle reg_put_nbi(int memid, void *dst, void *src, size_t size,
+                               int target, process_config& config);
+        rma_handle get_nbi(void *dst, void *src, size_t size, int target,
+                           process_config& config);
+        rma_handle reg_get_nbi(int memid, void *dst, void *src, size_t size,
+                               int target, process_config& config);
 //         void raw_put(int tag, void *dst, void *src, size_t size, int target,
 //                      int me);
 //         void raw_put_ordered(int tag, void *dst, void *src, size_t size,
@@ -67,6 +68,12 @@ namespace comm {
         void raw_get(int memid, void *dst, void *src, size_t size,
                      int target, int flags, int me);
         int  poll(int *tag_out, int *pid_out, process_config& config);
+
+        // puts and gets are blocking
+        bool test(const rma_handle&) { return true; }
+        void wait(const rma_handle&) {}
+        void wait_all(const rma_handle [], size_t) {}
+
         void fence();
         void native_barrier(process_config& config);
 
@@ -79,6 +86,10 @@ namespace comm {
         template <class T>
         T fetch_and_add(T *dst, T value, int target, process_config& config);
 
+        template <class T>
+        bool compare_and_swap(T *dst, T old_v, T new_v, int target,
+                              process_config& config);
+
         void request(int tag, void *p, size_t size, int pid,
                      process_config& config)
         { MADI_UNDEFINED; }
@@ -2,6 +2,7 @@
 #define MADM_COMM_TYPES_H
 
 #include "madm_misc.h"
+#include "rma_handle.h"
 #include <cstddef>
 
 namespace madi {
@@ -24,11 +25,20 @@ namespace comm {
     pid_t get_pid();
     size_t get_n_procs();
 
+    // collective: all processes must call it with the same size and in
+    // the same order as coll_rma_free, so that the returned addresses
+    // can be computed without communication (MADM_SYMMETRIC_HEAP)
     template <class T>
     T ** coll_rma_malloc(size_t size);
     template <class T>
     void coll_rma_free(T **ptrs);
 
+    // local: on the MPI-3 and shmem layers, allocates without
+    // communication from a heap of MADM_RMA_LOCAL_HEAP_SIZE bytes (default
+    // 8 MB) reserved in each process at initialization.
+    // NOTE: unlike the collective heap used before, this heap does not
+    // grow. rma_malloc aborts the program when it is exhausted.
+    // MADM_RMA_LOCAL_HEAP_SIZE=0 restores the collective, growing heap.
     template <class T>
     T * rma_malloc(size_t size);
     template <class T>
@@ -42,12 +52,19 @@ namespace comm {
     template <class T>
     T get_value(T *src, pid_t target);
 
-    void put_nbi(void *dst, void *src, size_t size, pid_t target);
-    void get_nbi(void *dst, void *src, size_t size, pid_t target);
+    rma_handle put_nbi(void *dst, void *src, size_t size, pid_t target);
+    rma_handle get_nbi(void *dst, void *src, size_t size, pid_t target);
+
+    bool test(const rma_handle& h);
+    void wait(const rma_handle& h);
+    void wait_all(const rma_handle hs[], size_t n);
 
     template <class T>
     T fetch_and_add(T *dst, T value, pid_t target);
 
+    template <class T>
+    bool compare_and_swap(T *dst, T old_v, T new_v, pid_t target);
+
     void fence();
     void poll();
 
@@ -56,6 +73,10 @@ namespace comm {
 
     void reg_put(int id, void *dst, void *src, size_t size, pid_t target);
     void reg_get(int id, void *dst, void *src, size_t size, pid_t target);
+    rma_handle reg_put_nbi(int id, void *dst, void *src, size_t size,
+                           pid_t target);
+    rma_handle reg_get_nbi(int id, void *dst, void *src, size_t size,
+                           pid_t target);
 
     void barrier();
     bool barrier_try();
@@ -93,6 +93,12 @@ namespace comm {
         return g.comm->fetch_and_add(dst, value, target);
     }
 
+    template <class T>
+    bool compare_and_swap(T *dst, T old_v, T new_v, pid_t target)
+    {
+        return g.comm->compare_and_swap(dst, old_v, new_v, target);
+    }
+
 }
 }
 
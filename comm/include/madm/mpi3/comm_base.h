@@ -5,6 +5,7 @@
 #include "../ampeer.h"
 #include "../process_config.h"
 #include "../allocator.h"
+#include "../rma_handle.h"
 #include "madm_misc.h"
 #include "madm_debug.h"
 
@@ -22,12 +23,38 @@ namespace comm {
     // base communication system for Fujitsu MPI
     class comm_base : noncopyable {
 
+        // operations issued to and completed at a target on a window
+        struct target_state {
+            uint64_t issued;
+            uint64_t completed;
+            bool pending;       // listed in pending_
+        };
+
         int tag_;
         comm_memory *cmr_;
         comm_allocator *comm_alc_;
         volatile long *value_buf_;
+
+        // slice of the RMA heap reserved for malloc/free, which allocate
+        // from it without synchronizing with other processes
+        void *local_heap_;
+        fixed_region *local_mr_;
+        allocator<fixed_region> *local_alc_;
+
+        // collective allocations are at the same offset in every process,
+        // because only coll_malloc/coll_free use comm_alc_ after
+        // initialization and all processes call them in the same order
+        bool symmetric_;
+
         process_config native_config_;
 
+        // targets_[window index][native pid], allocated at the first
+        // operation on the window
+        std::vector<std::vector<target_state> > targets_;
+
+        // (window index, native pid) which may have outstanding operations
+        std::vector<std::pair<int, int> > pending_;
+
     public:
         comm_base(int& argc, char **& argv);
         ~comm_base();
@@ -40,25 +67,31 @@ namespace comm {
         void free(void *p, process_config& config);
         int  coll_mmap(uint8_t *addr, size_t size, process_config& config);
         void coll_munmap(int memid, process_config& config);
-        void put_nbi(void *dst, void *src, size_t size, int target,
-                     process_config& config);
-        void reg_put_nbi(int memid, void *dst, void *src, size_t size,
-                         int target, process_config& config);
-        void get_nbi(void *dst, void *src, size_t size, int target,
-                     process_config& config);
-        void reg_get_nbi(int memid, void *dst, void *src, size_t size,
-                         int target, process_config& config);
+        rma_handle put_nbi(void *dst, void *src, size_t size, int target,
+                           process_config& config);
+        rma_handle reg_put_nbi(int memid, void *dst, void *src, size_t size,
+                               int target, process_config& config);
+        rma_handle get_nbi(void *dst, void *src, size_t size, int target,
+                           process_config& config);
+        rma_handle reg_get_nbi(int memid, void *dst, void *src, size_t size,
+                               int target, process_config& config);
 //         void raw_put(int tag, void *dst, void *src, size_t size, int target,
 //                      int me);
 //         void raw_put_ordered(int tag, void *dst, void *src, size_t size,
 //                              int target, int me);
 //         void raw_put_with_notice(int tag, void *dst, void *src, size_t size,
 //                                  int target, int me);
-        void raw_put__(int memid, void *dst, void *src, size_t size,
-                       int target, int flags, int me);
-        void raw_get(int memid, void *dst, void *src, size_t size,
-                     int target, int flags, int me);
+        rma_handle raw_put__(int memid, void *dst, void *src, size_t size,
+                             int target, int flags, int me);
+        rma_handle raw_get(int memid, void *dst, void *src, size_t size,
+                           int target, int flags, int me);
         int  poll(int *tag_out, int *pid_out, process_config& config);
+
+        // MPI-3 has no non-blocking flush, so test completes h as wait
+        // does. both flush only the target and window of h.
+        bool test(const rma_handle& h);
+        void wait(const rma_handle& h);
+        void wait_all(const rma_handle hs[], size_t n);
         void fence();
         void sync();
         void native_barrier(process_config& config);
@@ -68,8 +101,7 @@ namespace comm {
         {
             *(T *)value_buf_ = value;
 
-            put_nbi(dst, (void *)value_buf_, sizeof(T), target, config);
-            fence();
+            wait(put_nbi(dst, (void *)value_buf_, sizeof(T), target, config));
         }
 
         template <class T>
@@ -79,8 +111,7 @@ namespace comm {
                 *value_buf_ = 0xFFFFFFFFFFFFFFFF;
             });
 
-            get_nbi((void *)value_buf_, src, sizeof(T), target, config);
-            fence();
+            wait(get_nbi((void *)value_buf_, src, sizeof(T), target, config));
 
             return *(T *)value_buf_;
         }
@@ -88,6 +119,10 @@ namespace comm {
         template <class T>
         T fetch_and_add(T *dst, T value, int target, process_config& config);
 
+        template <class T>
+        bool compare_and_swap(T *dst, T old_v, T new_v, int target,
+                              process_config& config);
+
         void request(int tag, void *p, size_t size, int pid,
                      process_config& config)
         { MADI_UNDEFINED; }
@@ -95,6 +130,10 @@ namespace comm {
         void reply(int tag, void *p, size_t size, aminfo *info,
                    process_config& config)
         { MADI_UNDEFINED; }
+
+    private:
+        rma_handle issued(int win_idx, int target);
+        void flush(int win_idx, int target);
     };
 
 }
@@ -26,16 +26,29 @@ namespace comm {
         uint8_t *region_begin_;
         uint8_t *region_end_;
 
+        // registered regions sorted by address, for translating pointers
+        // given without a memid
+        struct region {
+            uint8_t *begin;
+            uint8_t *end;
+            int memid;
+        };
+        std::vector<region> regions_;
+
     public:
         explicit comm_memory(process_config& config);
         ~comm_memory();
 
         size_t size() const;
 
+        // start of the RMA heap of a process (native pid)
+        uint8_t * base_address(int pid) const;
+
         std::vector<MPI_Win>& windows() { return wins_; }
 
-        void translate(int memid, void *p, size_t size, int target,
-                       size_t *target_disp, MPI_Win *win);
+        // returns the index of the window in windows()
+        int translate(int memid, void *p, size_t size, int target,
+                      size_t *target_disp, MPI_Win *win);
 
         void * extend_to(size_t size, process_config& config);
 
@@ -45,10 +58,10 @@ namespace comm {
     private:
         size_t index_of_memid(int memid) const;
         size_t memid_of_index(int idx) const;
-        uint8_t * base_address(int pid) const;
         void * extend(process_config& config);
         void coll_mmap_with_id(int memid, uint8_t *addr, size_t size,
                                process_config& config);
+        int find_region(uint8_t *p) const;
     };
 
 }
@@ -16,6 +16,14 @@ namespace comm {
                                         //   for GASNet active messaging or not
         int debug_level;                // debug level (enabled only if
                                         //   configured with debug option)
+        int alloc_stats;                // print the fragmentation of the
+                                        //   RMA heap at finalization
+        size_t rma_local_heap_size;     // bytes reserved at initialization
+                                        //   for rma_malloc in each process
+                                        //   (0: rma_malloc is collective)
+        int symmetric_heap;             // compute coll_rma_malloc addresses
+                                        //   without communication (needs
+                                        //   rma_local_heap_size > 0)
     };
 
     extern options options;
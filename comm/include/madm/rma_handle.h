@@ -0,0 +1,31 @@
+#ifndef MADI_RMA_HANDLE_H
+#define MADI_RMA_HANDLE_H
+
+#include <cstdint>
+
+namespace madi {
+namespace comm {
+
+    // completion token of a non-blocking RMA operation (put_nbi/get_nbi).
+    //
+    // a token is a plain value: it may be copied, waited on more than
+    // once, or ignored, in which case the operation completes at the
+    // next fence. waiting on a token completes the operations issued
+    // to its target on its window up to it, and no others.
+    struct rma_handle {
+        int win;        // backend-specific window, or -1 if the operation
+                        // completed when it was issued
+        int target;     // native pid of the target
+        uint64_t seq;   // sequence number of the operation on (win, target)
+
+        static rma_handle completed()
+        {
+            rma_handle h = { -1, -1, 0 };
+            return h;
+        }
+    };
+
+}
+}
+
+#endif
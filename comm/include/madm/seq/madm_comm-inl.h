@@ -125,6 +125,17 @@ namespace comm {
         return result;
     }
 
+    template <class T>
+    bool compare_and_swap(T *dst, T old_v, T new_v, pid_t target)
+    {
+        if (*dst != old_v)
+            return false;
+
+        *dst = new_v;
+
+        return true;
+    }
+
     void reduce_long(long dst[], const long src[], size_t size, pid_t root, 
                      reduce_op op);
 
@@ -46,6 +46,17 @@ namespace comm {
         return threadsafe::fetch_and_add(remote_dst, value);
     }
 
+    template <class T>
+    inline bool comm_base::compare_and_swap(T *dst, T old_v, T new_v,
+                                            int target,
+                                            process_config& config)
+    {
+        auto remote_dst = cm_->translate(comm_memory::MEMID_DEFAULT,
+                                         dst, sizeof(T), target);
+
+        return threadsafe::compare_and_swap(remote_dst, old_v, new_v);
+    }
+
 }
 }
 
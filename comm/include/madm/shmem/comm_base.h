@@ -3,6 +3,7 @@
 
 #include "../process_config.h"
 #include "../allocator.h"
+#include "../rma_handle.h"
 #include "madm_misc.h"
 #include "madm_debug.h"
 
@@ -19,6 +20,7 @@ namespace comm {
     class comm_base : noncopyable {
 
         typedef allocator<comm_memory> cm_allocator;
+        typedef allocator<fixed_region> local_allocator;
 
         process_config native_config_;
 
@@ -28,9 +30,20 @@ namespace comm {
         // allocator for inter-process shared memory
         unique_ptr<cm_allocator> comm_alc_;
 
+        // slice of the shared memory reserved for malloc/free, which
+        // allocate from it without synchronizing with other processes
+        void *local_heap_;
+        unique_ptr<fixed_region> local_mr_;
+        unique_ptr<local_allocator> local_alc_;
+
+        // collective allocations are at the same offset in every process,
+        // because only coll_malloc/coll_free use comm_alc_ after
+        // initialization and all processes call them in the same order
+        bool symmetric_;
+
     public:
         explicit comm_base(int& argc, char **& argv);
-        ~comm_base() = default;
+        ~comm_base();
 
         process_config& native_config() { return native_config_; }
 
@@ -43,17 +56,22 @@ namespace comm {
         int coll_mmap(uint8_t *addr, size_t size, process_config& config);
         void coll_munmap(int memid, process_config& config);
 
-        void put_nbi(void *dst, void *src, size_t size, int target,
-                     process_config& config);
+        // operations complete when they are issued
+        rma_handle put_nbi(void *dst, void *src, size_t size, int target,
+                           process_config& config);
+
+        rma_handle get_nbi(void *dst, void *src, size_t size, int target,
+                           process_config& config);
 
-        void get_nbi(void *dst, void *src, size_t size, int target,
-                     process_config& config);
+        rma_handle reg_put_nbi(int memid, void *dst, void *src, size_t size,
+                               int target, process_config& config);
 
-        void reg_put_nbi(int memid, void *dst, void *src, size_t size,
-                         int target, process_config& config);
+        rma_handle reg_get_nbi(int memid, void *dst, void *src, size_t size,
+                               int target, process_config& config);
 
-        void reg_get_nbi(int memid, void *dst, void *src, size_t size,
-                         int target, process_config& config);
+        bool test(const rma_handle& h);
+        void wait(const rma_handle& h);
+        void wait_all(const rma_handle hs[], size_t n);
 
         int poll(int *tag_out, int *pid_out, process_config& config);
 
@@ -69,6 +87,10 @@ namespace comm {
         template <class T>
         T fetch_and_add(T *dst, T value, int target, process_config& config);
 
+        template <class T>
+        bool compare_and_swap(T *dst, T old_v, T new_v, int target,
+                              process_config& config);
+
         void request(int tag, void *p, size_t size, int pid,
                      process_config& config)
         { MADI_UNDEFINED; }
@@ -90,6 +90,9 @@ namespace comm {
         size_t size() const;
         void * extend_to(size_t size, process_config& config);
 
+        // start of the default shared memory of a process (native pid)
+        uint8_t * base_address(int pid) const;
+
     private:
         void * extend(process_config& config);
         void coll_mmap_with_id(uint8_t *addr, size_t size,
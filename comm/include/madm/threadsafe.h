@@ -13,6 +13,18 @@ namespace comm {
             return __sync_bool_compare_and_swap(dst, old_v, new_v);
         }
 
+        template <class T>
+        static bool compare_and_swap(T *dst, T old_v, T new_v)
+        {
+            return __sync_bool_compare_and_swap(dst, old_v, new_v);
+        }
+
+        template <class T>
+        static bool compare_and_swap(volatile T *dst, T old_v, T new_v)
+        {
+            return __sync_bool_compare_and_swap(dst, old_v, new_v);
+        }
+
         static void swap(volatile int *dst, int *src)
         {
             int new_v = *src;
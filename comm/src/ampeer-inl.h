@@ -3,6 +3,7 @@
 
 #include "ampeer.h"
 #include "fetch_and_add.h"
+#include "compare_and_swap.h"
 
 #include <deque>
 #include <cstddef>
@@ -367,6 +368,18 @@ namespace comm {
                 case AM_FETCH_AND_ADD_LONG_REP:
                     fetch_and_add_rep<long>::amhandle(data, size, pid, info);
                     return true;
+                case AM_COMPARE_AND_SWAP_INT_REQ:
+                    compare_and_swap_req<int>::amhandle(data, size, pid, info,
+                                               AM_COMPARE_AND_SWAP_INT_REP);
+                    return true;
+                case AM_COMPARE_AND_SWAP_LONG_REQ:
+                    compare_and_swap_req<long>::amhandle(data, size, pid, info,
+                                               AM_COMPARE_AND_SWAP_LONG_REP);
+                    return true;
+                case AM_COMPARE_AND_SWAP_INT_REP:
+                case AM_COMPARE_AND_SWAP_LONG_REP:
+                    compare_and_swap_rep::amhandle(data, size, pid, info);
+                    return true;
                 default:
                     MADI_NOT_REACHED;
                     return true;
@@ -574,6 +587,29 @@ namespace comm {
         return result;
     }
 
+    template <class T> struct compare_and_swap_tag;
+    template <> struct compare_and_swap_tag<int>
+    { enum { value = AM_COMPARE_AND_SWAP_INT_REQ }; };
+    template <> struct compare_and_swap_tag<long>
+    { enum { value = AM_COMPARE_AND_SWAP_LONG_REQ }; };
+
+    template <class CB>
+    template <class T>
+    bool ampeer<CB>::compare_and_swap(T *dst, T old_v, T new_v, int target,
+                                      process_config& config)
+    {
+        compare_and_swap_req<T> req(dst, old_v, new_v);
+
+        int tag = compare_and_swap_tag<T>::value;
+        req.request(tag, target);
+
+        bool result;
+        while (!req.test(&result))
+            madi::comm::poll();
+
+        return result;
+    }
+
 }
 }
 
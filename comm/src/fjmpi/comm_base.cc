@@ -111,32 +111,40 @@ namespace comm {
         cmr_->coll_munmap(memid, config);
     }
 
-    void comm_core::put_nbi(void *dst, void *src, size_t size, int target,
-                            process_config& config)
+    rma_handle comm_core::put_nbi(void *dst, void *src, size_t size,
+                                  int target, process_config& config)
     {
-        reg_put_nbi(-1, dst, src, size, target, config);
+        return reg_put_nbi(-1, dst, src, size, target, config);
     }
 
-    void comm_core::reg_put_nbi(int memid, void *dst, void *src, size_t size,
-                                int target, process_config& config)
+    rma_handle comm_core::reg_put_nbi(int memid, void *dst, void *src,
+                                      size_t size, int target,
+                                      process_config& config)
     {
         int pid = config.native_pid(target);
         int me = config.get_native_pid();
         raw_put__(memid, dst, src, size, pid, tag_, 0, me);
+
+        rma_handle h = { 0, pid, 0 };
+        return h;
     }
 
-    void comm_core::get_nbi(void *dst, void *src, size_t size, int target,
-                            process_config& config)
+    rma_handle comm_core::get_nbi(void *dst, void *src, size_t size,
+                                  int target, process_config& config)
     {
-        reg_get_nbi(-1, dst, src, size, target, config);
+        return reg_get_nbi(-1, dst, src, size, target, config);
     }
 
-    void comm_core::reg_get_nbi(int memid, void *dst, void *src, size_t size,
-                                int target, process_config& config)
+    rma_handle comm_core::reg_get_nbi(int memid, void *dst, void *src,
+                                      size_t size, int target,
+                                      process_config& config)
     {
         int pid = config.native_pid(target);
         int me = config.get_native_pid();
         raw_get(memid, dst, src, size, pid, tag_, 0, me);
+
+        rma_handle h = { 0, pid, 0 };
+        return h;
     }
 
     void comm_core::raw_put(int tag, void *dst, void *src, size_t size,
@@ -327,6 +335,12 @@ namespace comm {
       fetch_and_add(int *dst, int value, int target, process_config& config);
     template long ampeer<comm_base>::
       fetch_and_add(long *dst, long value, int target, process_config& config);
+    template bool ampeer<comm_base>::
+      compare_and_swap(int *dst, int old_v, int new_v, int target,
+                       process_config& config);
+    template bool ampeer<comm_base>::
+      compare_and_swap(long *dst, long old_v, long new_v, int target,
+                       process_config& config);
 
 }
 }
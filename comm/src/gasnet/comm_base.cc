@@ -47,6 +47,9 @@ namespace comm {
         AM_FAD_INT_REP,
         AM_FAD_LONG_REQ,
         AM_FAD_LONG_REP,
+        AM_CAS_INT_REQ,
+        AM_CAS_LONG_REQ,
+        AM_CAS_REP,
     };
 
     class join_counter : noncopyable {
@@ -215,6 +218,64 @@ namespace comm {
         return buf.get();
     }
 
+    template <class T> T am_cas_req_tag();
+    template <> int  am_cas_req_tag() { return AM_CAS_INT_REQ; }
+    template <> long am_cas_req_tag() { return AM_CAS_LONG_REQ; }
+
+    void handle_compare_and_swap_rep(gasnet_token_t,
+                                     gasnet_handlerarg_t result_value,
+                                     gasnet_handlerarg_t buf_high,
+                                     gasnet_handlerarg_t buf_low)
+    {
+        bool result = (result_value != 0);
+        sync_var<bool> *buf = MAKEWORD(sync_var<bool> *, buf_high, buf_low);
+
+        buf->set(result);
+    }
+
+    // 32-bit values are also sent in two words
+    template <class T>
+    void handle_compare_and_swap_req(gasnet_token_t token,
+                                     gasnet_handlerarg_t ptr_high,
+                                     gasnet_handlerarg_t ptr_low,
+                                     gasnet_handlerarg_t old_high,
+                                     gasnet_handlerarg_t old_low,
+                                     gasnet_handlerarg_t new_high,
+                                     gasnet_handlerarg_t new_low,
+                                     gasnet_handlerarg_t buf_high,
+                                     gasnet_handlerarg_t buf_low)
+    {
+        T *p = MAKEWORD(T *, ptr_high, ptr_low);
+        T old_v = MAKEWORD(T, old_high, old_low);
+        T new_v = MAKEWORD(T, new_high, new_low);
+
+        bool result = threadsafe::compare_and_swap(p, old_v, new_v);
+
+        gasnet_AMReplyShort3(token, AM_CAS_REP,
+                             (uint32_t)result, buf_high, buf_low);
+    }
+
+    template <class T>
+    bool am_compare_and_swap(T *p, T old_v, T new_v, int target)
+    {
+        sync_var<bool> buf;
+
+        uint32_t ptr_high = HIWORD(p);
+        uint32_t ptr_low  = LOWORD(p);
+        uint32_t old_high = HIWORD(old_v);
+        uint32_t old_low  = LOWORD(old_v);
+        uint32_t new_high = HIWORD(new_v);
+        uint32_t new_low  = LOWORD(new_v);
+        uint32_t buf_high = HIWORD(&buf);
+        uint32_t buf_low  = LOWORD(&buf);
+
+        gasnet_AMRequestShort8(target, am_cas_req_tag<T>(),
+                               ptr_high, ptr_low, old_high, old_low,
+                               new_high, new_low, buf_high, buf_low);
+
+        return buf.get();
+    }
+
    
     void * poll_thread_start(void *p)
     {
@@ -252,6 +313,12 @@ namespace comm {
               (void (*)())handle_fetch_and_add_i64_req<long> },
             { AM_FAD_LONG_REP,
               (void (*)())handle_fetch_and_add_i64_rep<long> },
+            { AM_CAS_INT_REQ,
+              (void (*)())handle_compare_and_swap_req<int> },
+            { AM_CAS_LONG_REQ,
+              (void (*)())handle_compare_and_swap_req<long> },
+            { AM_CAS_REP,
+              (void (*)())handle_compare_and_swap_rep },
         };
         int n_amentries = sizeof(amentries) / sizeof(*amentries);
 
@@ -400,28 +467,32 @@ namespace comm {
         MADI_UNDEFINED;
     }
 
-    void comm_base::put_nbi(void *dst, void *src, size_t size, int target,
-                            process_config& config)
+    rma_handle comm_base::put_nbi(void *dst, void *src, size_t size,
+                                  int target, process_config& config)
     {
         gasnet_put_bulk(target, dst, src, size);
+        return rma_handle::completed();
     }
 
-    void comm_base::reg_put_nbi(int memid, void *dst, void *src, size_t size,
-                                int target, process_config& config)
+    rma_handle comm_base::reg_put_nbi(int memid, void *dst, void *src,
+                                      size_t size, int target,
+                                      process_config& config)
     {
-        put_nbi(dst, src, size, target, config);
+        return put_nbi(dst, src, size, target, config);
     }
 
-    void comm_base::get_nbi(void *dst, void *src, size_t size, int target,
-                            process_config& config)
+    rma_handle comm_base::get_nbi(void *dst, void *src, size_t size,
+                                  int target, process_config& config)
     {
         gasnet_get_bulk(dst, target, src, size);
+        return rma_handle::completed();
     }
 
-    void comm_base::reg_get_nbi(int memid, void *dst, void *src, size_t size,
-                                int target, process_config& config)
+    rma_handle comm_base::reg_get_nbi(int memid, void *dst, void *src,
+                                      size_t size, int target,
+                                      process_config& config)
     {
-        get_nbi(dst, src, size, target, config);
+        return get_nbi(dst, src, size, target, config);
     }
 
     int comm_base::poll(int *tag_out, int *pid_out, process_config& config)
@@ -481,6 +552,17 @@ namespace comm {
             return am_fetch_and_add_i64(dst, value, target);
     }
 
+    template <class T>
+    bool comm_base::compare_and_swap(T *dst, T old_v, T new_v, int target,
+                                     process_config& config)
+    {
+        static_assert(sizeof(T) == sizeof(int32_t) ||
+                      sizeof(T) == sizeof(int64_t),
+                      "T must be a 32 or 64 bit type");
+
+        return am_compare_and_swap(dst, old_v, new_v, target);
+    }
+
     // template instantiation for put_value
     template void comm_base::put_value(int *, int, int, process_config&);
     template void comm_base::put_value(long *, long, int, process_config&);
@@ -504,6 +586,12 @@ namespace comm {
                                                process_config&);
     template long comm_base::fetch_and_add<long>(long *, long, int,
                                                  process_config&);
+
+    // template instantiation for compare_and_swap
+    template bool comm_base::compare_and_swap<int>(int *, int, int, int,
+                                                   process_config&);
+    template bool comm_base::compare_and_swap<long>(long *, long, long, int,
+                                                    process_config&);
 }
 }
 
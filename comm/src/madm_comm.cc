@@ -89,11 +89,11 @@ namespace comm {
         g.comm->fence();
     }
 
-    void put_nbi(void *dst, void *src, size_t size, pid_t target)
+    rma_handle put_nbi(void *dst, void *src, size_t size, pid_t target)
     {
         MADI_ASSERT(0 <= target && target < get_n_procs());
 
-        g.comm->put_nbi(dst, src, size, target);
+        return g.comm->put_nbi(dst, src, size, target);
     }
 
     void put(void *dst, void *src, size_t size, pid_t target)
@@ -103,11 +103,11 @@ namespace comm {
         g.comm->put(dst, src, size, target);
     }
 
-    void get_nbi(void *dst, void *src, size_t size, pid_t target)
+    rma_handle get_nbi(void *dst, void *src, size_t size, pid_t target)
     {
         MADI_ASSERT(0 <= target && target < get_n_procs());
 
-        g.comm->get_nbi(dst, src, size, target);
+        return g.comm->get_nbi(dst, src, size, target);
     }
 
     void get(void *dst, void *src, size_t size, pid_t target)
@@ -117,6 +117,21 @@ namespace comm {
         g.comm->get(dst, src, size, target);
     }
 
+    bool test(const rma_handle& h)
+    {
+        return g.comm->test(h);
+    }
+
+    void wait(const rma_handle& h)
+    {
+        g.comm->wait(h);
+    }
+
+    void wait_all(const rma_handle hs[], size_t n)
+    {
+        g.comm->wait_all(hs, n);
+    }
+
     int reg_coll_mmap(void *addr, size_t size)
     {
         return g.comm->coll_mmap((uint8_t *)addr, size);
@@ -131,16 +146,30 @@ namespace comm {
     {
         MADI_ASSERT(0 <= target && target < get_n_procs());
 
-        g.comm->reg_put_nbi(id, dst, src, size, target);
-        fence();
+        wait(g.comm->reg_put_nbi(id, dst, src, size, target));
     }
 
     void reg_get(int id, void *dst, void *src, size_t size, pid_t target)
     {
         MADI_ASSERT(0 <= target && target < get_n_procs());
 
-        g.comm->reg_get_nbi(id, dst, src, size, target);
-        fence();
+        wait(g.comm->reg_get_nbi(id, dst, src, size, target));
+    }
+
+    rma_handle reg_put_nbi(int id, void *dst, void *src, size_t size,
+                           pid_t target)
+    {
+        MADI_ASSERT(0 <= target && target < get_n_procs());
+
+        return g.comm->reg_put_nbi(id, dst, src, size, target);
+    }
+
+    rma_handle reg_get_nbi(int id, void *dst, void *src, size_t size,
+                           pid_t target)
+    {
+        MADI_ASSERT(0 <= target && target < get_n_procs());
+
+        return g.comm->reg_get_nbi(id, dst, src, size, target);
     }
 
     void barrier()
@@ -2,6 +2,7 @@
 #include "mpi3/comm_memory.h"
 #include "ampeer.h"
 #include "options.h"
+#include "symmetric_heap.h"
 
 #include <mpi.h>
 #include <mpi-ext.h>
@@ -21,19 +22,57 @@ namespace comm {
         : cmr_(NULL)
         , comm_alc_(NULL)
         , value_buf_(NULL)
+        , local_heap_(NULL)
+        , local_mr_(NULL)
+        , local_alc_(NULL)
+        , symmetric_(false)
         , native_config_()
+        , targets_()
+        , pending_()
     {
         cmr_ = new comm_memory(native_config_);
+        targets_.resize(cmr_->windows().size());
 
         // initialize basic RDMA features (malloc/free/put/get)
         comm_alc_ = new allocator<comm_memory>(cmr_);
 
         value_buf_ = (long *)comm_alc_->allocate(sizeof(long), native_config_);
+
+        // all processes reserve the local heap here, so that the
+        // collective extension of the RMA heap does not happen in malloc.
+        size_t page_size = options.page_size;
+        size_t size = (options.rma_local_heap_size + page_size - 1)
+                    / page_size * page_size;
+
+        if (size > 0) {
+            local_heap_ = comm_alc_->allocate(size, native_config_);
+            MADI_CHECK(local_heap_ != NULL);
+
+            local_mr_ = new fixed_region(local_heap_, size);
+            local_alc_ = new allocator<fixed_region>(local_mr_);
+
+            symmetric_ = options.symmetric_heap;
+        }
     }
 
     comm_base::~comm_base()
     {
+        int me = native_config_.get_pid();
+
+        if (local_alc_ != NULL) {
+            if (options.alloc_stats)
+                local_alc_->print_stats(stdout, "local", me);
+
+            delete local_alc_;
+            delete local_mr_;
+            comm_alc_->deallocate(local_heap_);
+        }
+
         comm_alc_->deallocate((void *)value_buf_);
+
+        if (options.alloc_stats)
+            comm_alc_->print_stats(stdout, "collective", me);
+
         delete comm_alc_;
         delete cmr_;
     }
@@ -50,9 +89,19 @@ namespace comm {
 
         MADI_ASSERT(p != NULL);
 
-        MPI_Allgather(&p, sizeof(p), MPI_BYTE, 
-                      ptrs, sizeof(p), MPI_BYTE,
-                      comm);
+        if (symmetric_) {
+            int me = config.get_native_pid();
+            size_t offset = (uint8_t *)p - cmr_->base_address(me);
+
+            verify_symmetric(offset, config);
+
+            for (int i = 0; i < n_procs; i++)
+                ptrs[i] = cmr_->base_address(config.native_pid(i)) + offset;
+        } else {
+            MPI_Allgather(&p, sizeof(p), MPI_BYTE,
+                          ptrs, sizeof(p), MPI_BYTE,
+                          comm);
+        }
 
         int me = config.get_pid();
         MADI_ASSERT(ptrs[me] != NULL);
@@ -72,12 +121,22 @@ namespace comm {
 
     void * comm_base::malloc(size_t size, process_config& config)
     {
-        MPI_Comm comm = config.comm();
+        if (local_alc_ != NULL) {
+            void *p = local_alc_->allocate(size, config);
 
-        // FIXME: non-collective implementation
-        // currently, the comm_allocater::allocate function may call
+            // the local heap does not grow (see madm_comm-decls.h)
+            if (p == NULL)
+                MADI_DIE("rma_malloc(%zu) failed: the local RMA heap "
+                         "(%zu bytes) is exhausted; increase "
+                         "MADM_RMA_LOCAL_HEAP_SIZE", size,
+                         local_mr_->capacity());
+
+            return p;
+        }
+
+        // without the local heap, comm_allocator::allocate may call
         // collective function `extend_to'.
-        MPI_Barrier(comm);
+        MPI_Barrier(config.comm());
 
         comm_allocator *alc = comm_alc_;
         return alc->allocate(size, config);
@@ -85,10 +144,12 @@ namespace comm {
 
     void comm_base::free(void *p, process_config& config)
     {
-        MPI_Comm comm = config.comm();
+        if (local_alc_ != NULL) {
+            local_alc_->deallocate(p);
+            return;
+        }
 
-        // FIXME: non-collective implementation
-        MPI_Barrier(comm);
+        MPI_Barrier(config.comm());
 
         comm_allocator *alc = comm_alc_;
         alc->deallocate(p);
@@ -101,35 +162,40 @@ namespace comm {
 
     void comm_base::coll_munmap(int memid, process_config& config)
     {
+        // the window may be reused by a later coll_mmap
+        fence();
+
         cmr_->coll_munmap(memid, config);
     }
 
-    void comm_base::put_nbi(void *dst, void *src, size_t size, int target,
-                            process_config& config)
+    rma_handle comm_base::put_nbi(void *dst, void *src, size_t size,
+                                  int target, process_config& config)
     {
-        reg_put_nbi(-1, dst, src, size, target, config);
+        return reg_put_nbi(-1, dst, src, size, target, config);
     }
 
-    void comm_base::reg_put_nbi(int memid, void *dst, void *src, size_t size,
-                                int target, process_config& config)
+    rma_handle comm_base::reg_put_nbi(int memid, void *dst, void *src,
+                                      size_t size, int target,
+                                      process_config& config)
     {
         int pid = config.native_pid(target);
         int me = config.get_native_pid();
-        raw_put__(memid, dst, src, size, pid, 0, me);
+        return raw_put__(memid, dst, src, size, pid, 0, me);
     }
 
-    void comm_base::get_nbi(void *dst, void *src, size_t size, int target,
-                            process_config& config)
+    rma_handle comm_base::get_nbi(void *dst, void *src, size_t size,
+                                  int target, process_config& config)
     {
-        reg_get_nbi(-1, dst, src, size, target, config);
+        return reg_get_nbi(-1, dst, src, size, target, config);
     }
 
-    void comm_base::reg_get_nbi(int memid, void *dst, void *src, size_t size,
-                                int target, process_config& config)
+    rma_handle comm_base::reg_get_nbi(int memid, void *dst, void *src,
+                                      size_t size, int target,
+                                      process_config& config)
     {
         int pid = config.native_pid(target);
         int me = config.get_native_pid();
-        raw_get(memid, dst, src, size, pid, 0, me);
+        return raw_get(memid, dst, src, size, pid, 0, me);
     }
 
 //     void comm_base::raw_put(int tag, void *dst, void *src, size_t size,
@@ -155,13 +221,14 @@ namespace comm {
 //         /* no handle */
 //     }
 //
-    void comm_base::raw_put__(int memid, void *dst, void *src, size_t size,
-                              int target, int flags, int me)
+    rma_handle comm_base::raw_put__(int memid, void *dst, void *src,
+                                    size_t size, int target, int flags,
+                                    int me)
     {
         if (target == me) {
             MADI_DPUTS3("memcpy(%p, %p, %zu)", dst, src, size);
             memcpy(dst, src, size);
-            return;
+            return rma_handle::completed();
         }
 
         MADI_ASSERT(0 <= target && target < native_config_.get_n_procs());
@@ -171,19 +238,21 @@ namespace comm {
         // calculate local/remote buffer address
         MPI_Win win;
         size_t target_disp;
-        cmr.translate(memid, dst, size, target, &target_disp, &win);
+        int idx = cmr.translate(memid, dst, size, target, &target_disp, &win);
 
         // issue
         MPI_Put(src, size, MPI_BYTE, target, target_disp, size, MPI_BYTE, win);
+
+        return issued(idx, target);
     }
 
-    void comm_base::raw_get(int memid, void *dst, void *src, size_t size,
-                            int target, int flags, int me)
+    rma_handle comm_base::raw_get(int memid, void *dst, void *src,
+                                  size_t size, int target, int flags, int me)
     {
         if (target == me) {
             MADI_DPUTS3("memcpy(%p, %p, %zu)", dst, src, size);
             memcpy(dst, src, size);
-            return;
+            return rma_handle::completed();
         }
 
         MADI_ASSERT(0 <= target && target < native_config_.get_n_procs());
@@ -193,10 +262,69 @@ namespace comm {
         // calculate local/remote buffer address
         MPI_Win win;
         size_t target_disp;
-        cmr.translate(memid, src, size, target, &target_disp, &win);
+        int idx = cmr.translate(memid, src, size, target, &target_disp, &win);
 
         // issue
         MPI_Get(dst, size, MPI_BYTE, target, target_disp, size, MPI_BYTE, win);
+
+        return issued(idx, target);
+    }
+
+    rma_handle comm_base::issued(int win_idx, int target)
+    {
+        std::vector<target_state>& states = targets_[win_idx];
+
+        if (states.empty()) {
+            target_state zero = { 0, 0, false };
+            states.resize(native_config_.get_n_procs(), zero);
+        }
+
+        target_state& st = states[target];
+
+        if (!st.pending) {
+            pending_.push_back(std::make_pair(win_idx, target));
+            st.pending = true;
+        }
+
+        st.issued += 1;
+
+        rma_handle h = { win_idx, target, st.issued };
+        return h;
+    }
+
+    // complete the operations issued to the target on the window
+    void comm_base::flush(int win_idx, int target)
+    {
+        target_state& st = targets_[win_idx][target];
+
+        if (st.completed == st.issued)
+            return;
+
+        MPI_Win_flush(target, cmr_->windows()[win_idx]);
+
+        st.completed = st.issued;
+    }
+
+    bool comm_base::test(const rma_handle& h)
+    {
+        wait(h);
+        return true;
+    }
+
+    void comm_base::wait(const rma_handle& h)
+    {
+        if (h.win == -1)
+            return;
+
+        if (targets_[h.win][h.target].completed < h.seq)
+            flush(h.win, h.target);
+    }
+
+    void comm_base::wait_all(const rma_handle hs[], size_t n)
+    {
+        // flush() skips the targets completed by earlier handles
+        for (size_t i = 0; i < n; i++)
+            wait(hs[i]);
     }
 
     int comm_base::poll(int *tag_out, int *pid_out, process_config& config)
@@ -207,9 +335,13 @@ namespace comm {
 
     void comm_base::fence()
     {
-        for (auto& win : cmr_->windows())
-            if (win != MPI_WIN_NULL)
-                MPI_Win_flush_all(win);
+        // only the targets which may have outstanding operations
+        for (auto& wt : pending_) {
+            flush(wt.first, wt.second);
+            targets_[wt.first][wt.second].pending = false;
+        }
+
+        pending_.clear();
     }
 
     void comm_base::sync()
@@ -237,7 +369,8 @@ namespace comm {
         // calculate local/remote buffer address
         MPI_Win win;
         size_t target_disp;
-        cmr_->translate(-1, dst, sizeof(T), target, &target_disp, &win);
+        int idx = cmr_->translate(-1, dst, sizeof(T), target, &target_disp,
+                                  &win);
 
         MPI_Datatype type = mpi_type<T>();
 
@@ -245,7 +378,7 @@ namespace comm {
         T result;
         MPI_Fetch_and_op(&value, &result, type, target, target_disp,
                          MPI_SUM, win);
-        MPI_Win_flush(target, win);
+        wait(issued(idx, target));
 
         return result;
     }
@@ -254,6 +387,32 @@ namespace comm {
                                                process_config&);
     template long comm_base::fetch_and_add<long>(long *, long, int,
                                                  process_config&);
+
+    template <class T>
+    bool comm_base::compare_and_swap(T *dst, T old_v, T new_v, int target,
+                                     process_config&)
+    {
+        // calculate local/remote buffer address
+        MPI_Win win;
+        size_t target_disp;
+        int idx = cmr_->translate(-1, dst, sizeof(T), target, &target_disp,
+                                  &win);
+
+        MPI_Datatype type = mpi_type<T>();
+
+        // issue
+        T result;
+        MPI_Compare_and_swap(&new_v, &old_v, &result, type, target,
+                             target_disp, win);
+        wait(issued(idx, target));
+
+        return result == old_v;
+    }
+
+    template bool comm_base::compare_and_swap<int>(int *, int, int, int,
+                                                   process_config&);
+    template bool comm_base::compare_and_swap<long>(long *, long, long, int,
+                                                    process_config&);
 }
 }
 
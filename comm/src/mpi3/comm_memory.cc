@@ -4,6 +4,7 @@
 #include "madm_misc.h"
 #include "madm_debug.h"
 
+#include <algorithm>
 #include <climits>
 #include <cerrno>
 #include <mpi.h>
@@ -32,11 +33,13 @@ namespace comm {
         : max_procs_per_node_(options.n_procs_per_node)
         , n_procs_per_node_(0)
         , wins_(256, MPI_WIN_NULL)
+        , size_(0)
         , rdma_addrs_(256, NULL)
         , rdma_idx_(0)
         , rdma_ids_(CMR_MAX_BITS - CMR_BASE_BITS, 256)
         , region_begin_(CMR_BASE_ADDR)
         , region_end_(region_begin_ + CMR_PROC_SIZE * CMR_MAX_SIZE)
+        , regions_()
     {
         int me = config.get_native_pid();
         int n_procs = config.get_native_n_procs();
@@ -72,8 +75,8 @@ namespace comm {
         return size_;
     }
 
-    void comm_memory::translate(int memid, void *p, size_t size, int pid,
-                                size_t *target_disp, MPI_Win *win)
+    int comm_memory::translate(int memid, void *p, size_t size, int pid,
+                               size_t *target_disp, MPI_Win *win)
     {
         uint8_t *ptr = (uint8_t *)p;
 
@@ -86,8 +89,10 @@ namespace comm {
 
             size_t offset = ptr - base_addr;
 
+            // window 0 is [0, CMR_BASE_SIZE), and window i (i > 0) is
+            // [2^(CMR_BASE_BITS + i - 1), 2^(CMR_BASE_BITS + i))
             size_t idx, offset2;
-            if (offset < CMR_MAX_SIZE) {
+            if (offset < CMR_BASE_SIZE) {
                 idx = 0;
                 offset2 = offset;
             } else {
@@ -103,6 +108,8 @@ namespace comm {
 
             *target_disp = offset2;
             *win = wins_[idx];
+
+            return (int)idx;
         } else if (memid != -1) {
             // coll_mmap region
 
@@ -124,38 +131,37 @@ namespace comm {
 
             *target_disp = offset;
             *win = wins_[idx];
-            
+
+            return idx;
         } else {
             // coll_mmap region
-            // FIXME: O(n) search
-
-            int memid = -1;
-            for (size_t i = rdma_ids_.from(); i < rdma_ids_.to(); i++) {
-                size_t idx = index_of_memid(i);
-                uint64_t *raddrs = rdma_addrs_[idx];
-
-                if (raddrs == NULL)
-                    continue;
-
-                uint8_t *addr = (uint8_t *)raddrs[-3];
-                size_t size = (size_t)raddrs[-2];
-                int id = (int)raddrs[-1];
-                
-                if (addr <= ptr && ptr < addr + size) {
-                    memid = id;
-                    break;
-                }
-            }
+
+            int memid = find_region(ptr);
 
             if (memid == -1) {
                 MADI_DIE("pointer %p is not registered for RDMA. "
                          "use coll_rma_malloc.", ptr);
             }
 
-            translate(memid, p, size, pid, target_disp, win);
+            return translate(memid, p, size, pid, target_disp, win);
         }
     }
 
+    // binary search of the registered region which contains p
+    int comm_memory::find_region(uint8_t *p) const
+    {
+        auto it = std::upper_bound(regions_.begin(), regions_.end(), p,
+                                   [](uint8_t *q, const region& r) {
+                                       return q < r.begin;
+                                   });
+
+        if (it == regions_.begin())
+            return -1;
+
+        --it;
+        return (p < it->end) ? it->memid : -1;
+    }
+
 //     uint64_t comm_memory::translate(void *p, size_t size, int pid)
 //     {
 //         uint8_t *ptr = (uint8_t *)p;
@@ -408,6 +414,13 @@ namespace comm {
         int idx = index_of_memid(memid);
         rdma_addrs_[idx] = raddrs;
 
+        region r = { addr, addr + size, memid };
+        auto it = std::upper_bound(regions_.begin(), regions_.end(), r,
+                                   [](const region& a, const region& b) {
+                                       return a.begin < b.begin;
+                                   });
+        regions_.insert(it, r);
+
         if (me == 1) {
             MADI_DPUTS1("size = %9zu, "
                        "mmap = %9.6f, reg = %9.6f, "
@@ -447,6 +460,13 @@ namespace comm {
 
         rdma_ids_.push(memid);
 
+        for (auto it = regions_.begin(); it != regions_.end(); ++it) {
+            if (it->memid == memid) {
+                regions_.erase(it);
+                break;
+            }
+        }
+
         // free memory
         munmap(addr, size);
 
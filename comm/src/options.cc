@@ -15,6 +15,9 @@ namespace comm {
         10,            // n_max_sends (heuristics: ~ # of cores within a node)
         0,                              // gasnet_poll_thread
         5,             // debug level (only if configured with debug option)
+        0,                              // alloc_stats
+        8 * 1024 * 1024,                // rma_local_heap_size
+        1,                              // symmetric_heap
     };
 
     template <class T>
@@ -52,6 +55,9 @@ namespace comm {
         set_option("MADM_SERVER_MOD", &options.server_mod);
         set_option("MADM_GASNET_POLL_THREAD", &options.gasnet_poll_thread);
         set_option("MADM_DEBUG_LEVEL", &options.debug_level);
+        set_option("MADM_ALLOC_STATS", &options.alloc_stats);
+        set_option("MADM_RMA_LOCAL_HEAP_SIZE", &options.rma_local_heap_size);
+        set_option("MADM_SYMMETRIC_HEAP", &options.symmetric_heap);
 
         // validate server_mod
         MADI_CHECK(options.server_mod <= options.n_procs_per_node);
@@ -1,14 +1,51 @@
 #include "shmem/comm_base.h"
 #include "options.h"
+#include "symmetric_heap.h"
 
 namespace madi {
 namespace comm {
 
     comm_base::comm_base(int& argc, char **& argv)
         : native_config_()
+        , local_heap_(NULL)
+        , symmetric_(false)
     {
         cm_ = make_unique<comm_memory>(native_config_);
         comm_alc_ = make_unique<cm_allocator>(cm_.get());
+
+        // all processes reserve the local heap here, so that the
+        // collective extension of the shared memory does not happen
+        // in malloc.
+        size_t page_size = options.page_size;
+        size_t size = (options.rma_local_heap_size + page_size - 1)
+                    / page_size * page_size;
+
+        if (size > 0) {
+            local_heap_ = comm_alc_->allocate(size, native_config_);
+            MADI_CHECK(local_heap_ != NULL);
+
+            local_mr_ = make_unique<fixed_region>(local_heap_, size);
+            local_alc_ = make_unique<local_allocator>(local_mr_.get());
+
+            symmetric_ = options.symmetric_heap;
+        }
+    }
+
+    comm_base::~comm_base()
+    {
+        int me = native_config_.get_pid();
+
+        if (local_alc_) {
+            if (options.alloc_stats)
+                local_alc_->print_stats(stdout, "local", me);
+
+            local_alc_.reset();
+            local_mr_.reset();
+            comm_alc_->deallocate(local_heap_);
+        }
+
+        if (options.alloc_stats)
+            comm_alc_->print_stats(stdout, "collective", me);
     }
 
     void ** comm_base::coll_malloc(size_t size, process_config& config)
@@ -22,9 +59,19 @@ namespace comm {
 
         MADI_ASSERT(p != NULL);
 
-        MPI_Allgather(&p, sizeof(p), MPI_BYTE, 
-                      ptrs, sizeof(p), MPI_BYTE,
-                      comm);
+        if (symmetric_) {
+            int me = config.get_native_pid();
+            size_t offset = (uint8_t *)p - cm_->base_address(me);
+
+            verify_symmetric(offset, config);
+
+            for (int i = 0; i < n_procs; i++)
+                ptrs[i] = cm_->base_address(config.native_pid(i)) + offset;
+        } else {
+            MPI_Allgather(&p, sizeof(p), MPI_BYTE,
+                          ptrs, sizeof(p), MPI_BYTE,
+                          comm);
+        }
 
         int me = config.get_pid();
         MADI_ASSERT(ptrs[me] != NULL);
@@ -43,22 +90,34 @@ namespace comm {
 
     void * comm_base::malloc(size_t size, process_config& config)
     {
-        MPI_Comm comm = config.comm();
+        if (local_alc_) {
+            void *p = local_alc_->allocate(size, config);
+
+            // the local heap does not grow (see madm_comm-decls.h)
+            if (p == NULL)
+                MADI_DIE("rma_malloc(%zu) failed: the local RMA heap "
+                         "(%zu bytes) is exhausted; increase "
+                         "MADM_RMA_LOCAL_HEAP_SIZE", size,
+                         local_mr_->capacity());
+
+            return p;
+        }
 
-        // FIXME: non-collective implementation
-        // currently, the comm_allocater::allocate function may call
+        // without the local heap, comm_allocator::allocate may call
         // collective function `extend_to'.
-        MPI_Barrier(comm);
+        MPI_Barrier(config.comm());
 
         return comm_alc_->allocate(size, config);
     }
 
     void comm_base::free(void *p, process_config& config)
     {
-        MPI_Comm comm = config.comm();
+        if (local_alc_) {
+            local_alc_->deallocate(p);
+            return;
+        }
 
-        // FIXME: non-collective implementation
-        MPI_Barrier(comm);
+        MPI_Barrier(config.comm());
 
         comm_alc_->deallocate(p);
     }
@@ -73,28 +132,34 @@ namespace comm {
         cm_->coll_munmap(memid, config);
     }
 
-    void comm_base::put_nbi(void *dst, void *src, size_t size, int target,
-                            process_config& config)
+    rma_handle comm_base::put_nbi(void *dst, void *src, size_t size,
+                                  int target, process_config& config)
     {
         do_put(comm_memory::MEMID_DEFAULT, dst, src, size, target, config);
+        return rma_handle::completed();
     }
 
-    void comm_base::reg_put_nbi(int memid, void *dst, void *src, size_t size,
-                                int target, process_config& config)
+    rma_handle comm_base::reg_put_nbi(int memid, void *dst, void *src,
+                                      size_t size, int target,
+                                      process_config& config)
     {
         do_put(memid, dst, src, size, target, config);
+        return rma_handle::completed();
     }
 
-    void comm_base::get_nbi(void *dst, void *src, size_t size, int target,
-                            process_config& config)
+    rma_handle comm_base::get_nbi(void *dst, void *src, size_t size,
+                                  int target, process_config& config)
     {
         do_get(comm_memory::MEMID_DEFAULT, dst, src, size, target, config);
+        return rma_handle::completed();
     }
 
-    void comm_base::reg_get_nbi(int memid, void *dst, void *src, size_t size,
-                                int target, process_config& config)
+    rma_handle comm_base::reg_get_nbi(int memid, void *dst, void *src,
+                                      size_t size, int target,
+                                      process_config& config)
     {
         do_get(memid, dst, src, size, target, config);
+        return rma_handle::completed();
     }
 
     void comm_base::do_put(int memid, void *dst, void *src, size_t size,
@@ -130,6 +195,23 @@ namespace comm {
         threadsafe::rwbarrier();
     }
 
+    bool comm_base::test(const rma_handle& h)
+    {
+        wait(h);
+        return true;
+    }
+
+    void comm_base::wait(const rma_handle&)
+    {
+        // order the copy with later accesses, as fence does
+        threadsafe::rwbarrier();
+    }
+
+    void comm_base::wait_all(const rma_handle [], size_t)
+    {
+        threadsafe::rwbarrier();
+    }
+
     void comm_base::native_barrier(process_config& config)
     {
         MPI_Comm comm = config.comm();
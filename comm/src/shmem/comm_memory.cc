@@ -102,11 +102,13 @@ namespace comm {
 
     void touch_pages(void *p, size_t size)
     {
-        uint8_t *array = reinterpret_cast<uint8_t *>(p);
+        // read, not write: the pages of other processes are mapped here
+        // after they may have started to use them (e.g., their free lists)
+        volatile uint8_t *array = reinterpret_cast<volatile uint8_t *>(p);
         size_t page_size = options.page_size;
 
         for (size_t i = 0; i < size; i += page_size)
-            array[i] = 0;
+            (void)array[i];
     }
 
     uint8_t * do_mmap(uint8_t *addr, size_t size, int fd, size_t offset)
@@ -289,6 +291,11 @@ namespace comm {
         return coll_shm_maps_[MEMID_DEFAULT]->size();
     }
 
+    uint8_t * comm_memory::base_address(int pid) const
+    {
+        return coll_shm_maps_[MEMID_DEFAULT]->address(pid);
+    }
+
     void * comm_memory::extend_to(size_t size, process_config& config)
     {
 #ifdef __APPLE__
@@ -0,0 +1,39 @@
+#ifndef MADI_SYMMETRIC_HEAP_H
+#define MADI_SYMMETRIC_HEAP_H
+
+#include "process_config.h"
+#include "madm_misc.h"
+#include "madm_debug.h"
+#include <mpi.h>
+#include <vector>
+
+namespace madi {
+namespace comm {
+
+    // checks that the offset of a collective allocation is the same in
+    // all processes (the heaps diverge if processes call coll_malloc with
+    // different sizes or in different orders)
+    inline void verify_symmetric(MADI_UNUSED size_t offset,
+                                 MADI_UNUSED process_config& config)
+    {
+#if MADI_DEBUG_LEVEL >= 1
+        int n_procs = config.get_n_procs();
+        std::vector<size_t> offsets(n_procs);
+
+        MPI_Allgather(&offset, sizeof(offset), MPI_BYTE,
+                      offsets.data(), sizeof(offset), MPI_BYTE,
+                      config.comm());
+
+        for (int i = 0; i < n_procs; i++) {
+            if (offsets[i] != offset)
+                MADI_DIE("asymmetric coll_malloc: offset %zu at pid %d, "
+                         "%zu at pid %d (set MADM_SYMMETRIC_HEAP=0)",
+                         offset, config.get_pid(), offsets[i], i);
+        }
+#endif
+    }
+
+}
+}
+
+#endif
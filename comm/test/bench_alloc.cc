@@ -0,0 +1,156 @@
+#include "../include/madm/allocator.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <time.h>
+#include <sys/mman.h>
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+// allocation churn: keeps n_slots blocks of mixed sizes alive and
+// replaces a random one at each step, as rma_malloc/rma_free do over
+// a long run. reports the time per allocate/deallocate pair and the
+// fragmentation of the heap at the end.
+
+class mem_region {
+    uint8_t *base_ptr_;
+    size_t size_;
+public:
+    mem_region() : base_ptr_((uint8_t *)0x30000000000), size_(0)
+    {
+    }
+
+    ~mem_region()
+    {
+        if (size_ != 0)
+            munmap(base_ptr_, size_);
+    }
+
+    size_t size() { return size_; }
+
+    template <class T>
+    void * extend_to(size_t size, T& param)
+    {
+        uint8_t *addr = base_ptr_ + size_;
+        size_t ext_size = size - size_;
+
+        int prot = PROT_READ | PROT_WRITE;
+        int flags = MAP_ANONYMOUS | MAP_PRIVATE | MAP_FIXED;
+        uint8_t *p = (uint8_t *)mmap(addr, ext_size, prot, flags, -1, 0);
+
+        MADI_ASSERT(p == addr);
+
+        size_ = size;
+        return p;
+    }
+};
+
+typedef madi::comm::allocator<mem_region> alloc;
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// 80% small (8-512 bytes), 15% medium (up to 4 KB), 5% large (up to 64 KB)
+static size_t random_size()
+{
+    int r = rand() % 100;
+    if (r < 80)
+        return 8 + rand() % 505;
+    else if (r < 95)
+        return 513 + rand() % 3584;
+    else
+        return 4097 + rand() % (60 * 1024);
+}
+
+int main(int argc, char **argv)
+{
+    int argidx = 1;
+    int n_slots = (argc >= argidx + 1) ? atoi(argv[argidx++]) : 4096;
+    int n_steps = (argc >= argidx + 1) ? atoi(argv[argidx++]) : 1000000;
+
+    mem_region mr;
+    alloc a(&mr);
+    int param = 0;
+
+    std::vector<uint8_t *> ptrs(n_slots);
+    std::vector<size_t> sizes(n_slots);
+
+    srand(12345);
+
+    for (int i = 0; i < n_slots; i++) {
+        sizes[i] = random_size();
+        ptrs[i] = (uint8_t *)a.allocate(sizes[i], param);
+        memset(ptrs[i], i & 0xff, sizes[i]);
+    }
+
+    double t0 = now();
+
+    for (int step = 0; step < n_steps; step++) {
+        int i = rand() % n_slots;
+
+        // check the first and last bytes survived other blocks' churn
+        assert(ptrs[i][0] == (uint8_t)(i & 0xff));
+        assert(ptrs[i][sizes[i] - 1] == (uint8_t)(i & 0xff));
+
+        a.deallocate(ptrs[i]);
+
+        sizes[i] = random_size();
+        ptrs[i] = (uint8_t *)a.allocate(sizes[i], param);
+
+        ptrs[i][0] = (uint8_t)(i & 0xff);
+        ptrs[i][sizes[i] - 1] = (uint8_t)(i & 0xff);
+    }
+
+    double t1 = now();
+
+    printf("n_slots = %d, n_steps = %d, %.1f ns/step\n",
+           n_slots, n_steps, (t1 - t0) * 1e9 / n_steps);
+
+    a.print_stats(stdout, "churn", 0);
+
+    for (int i = 0; i < n_slots; i++)
+        a.deallocate(ptrs[i]);
+
+    return 0;
+}
+
+extern "C" {
+    
+    int madi_initialized()
+    {
+        return 1;
+    }
+
+    size_t madi_get_pid()
+    {
+        return 0;
+    }
+
+    void madi_exit(int exitcode)
+    {
+        exit(exitcode);
+    }
+
+    int madi_dprint_raw(const char *format, ...)
+    {
+        va_list arg;
+
+        FILE *out = stderr;
+
+        va_start(arg, format);
+        int r = vfprintf(out, format, arg);
+        va_end(arg);
+
+        fflush(out);
+
+        return r;
+    }
+
+}
@@ -23,7 +23,8 @@ public:
 
     size_t size() { return size_; }
 
-    void * extend_to(size_t size)
+    template <class T>
+    void * extend_to(size_t size, T& param)
     {
         if (size == 0)
             size = 4096;
@@ -49,12 +50,13 @@ int main(int argc, char **argv)
 {
     mem_region mr;
     alloc a(&mr);
+    int param = 0;
 
     void *ptrs[32];
     for (int i = 0; i < 32; i++) {
         int v = i + 1;
 
-        void *p = a.allocate(100 * v);
+        void *p = a.allocate(100 * v, param);
 
         memset(p, v, 100 * v);
 
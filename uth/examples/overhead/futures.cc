@@ -0,0 +1,239 @@
+#include <uth.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <alloca.h>
+
+#include <new>
+
+// future pool stress test.
+//
+// every node of a `width'-ary tree of depth `depth' spawns all of its
+// children before it touches any of them, so up to width futures per
+// level are outstanding on each running path and width^depth futures are
+// created in total, spread over processes by work stealing. a second run
+// returns 4 KiB values, which need entries of a larger size class than
+// the first run left behind. the chunks which drain are reused by it.
+//
+// a third run keeps `n_outstanding' futures outstanding at once, in two
+// size classes, before it touches any of them. the pools grow by many
+// chunks, which return to the free lists once the futures are touched.
+
+struct big {
+    long v[512];
+};
+
+struct mid {
+    long v[4];
+};
+
+static long leaf_long() { return 1; }
+
+static big leaf_big()
+{
+    big b;
+    b.v[0] = 1;
+    b.v[511] = 1;
+    return b;
+}
+
+static mid leaf_mid()
+{
+    mid m;
+    m.v[0] = 1;
+    m.v[3] = 1;
+    return m;
+}
+
+static long tree_long(int width, int depth)
+{
+    if (depth == 0)
+        return leaf_long();
+
+    madm::future<long> *fs =
+        (madm::future<long> *)alloca(sizeof(madm::future<long>) * width);
+
+    for (int i = 0; i < width; i++)
+        new (&fs[i]) madm::future<long>(tree_long, width, depth - 1);
+
+    long sum = 0;
+    for (int i = width - 1; i >= 0; i--)
+        sum += fs[i].touch();
+
+    return sum;
+}
+
+static long tree_big(int width, int depth)
+{
+    madm::future<big> *fs =
+        (madm::future<big> *)alloca(sizeof(madm::future<big>) * width);
+
+    if (depth == 1) {
+        for (int i = 0; i < width; i++)
+            new (&fs[i]) madm::future<big>(leaf_big);
+
+        long sum = 0;
+        for (int i = width - 1; i >= 0; i--) {
+            big b = fs[i].touch();
+            sum += b.v[0] * b.v[511];
+        }
+        return sum;
+    }
+
+    madm::future<long> *gs =
+        (madm::future<long> *)alloca(sizeof(madm::future<long>) * width);
+
+    for (int i = 0; i < width; i++)
+        new (&gs[i]) madm::future<long>(tree_big, width, depth - 1);
+
+    long sum = 0;
+    for (int i = width - 1; i >= 0; i--)
+        sum += gs[i].touch();
+
+    return sum;
+}
+
+static double n_nodes(int width, int depth)
+{
+    double n = 0.0, w = 1.0;
+    for (int i = 0; i < depth; i++) {
+        w *= width;
+        n += w;
+    }
+    return n;
+}
+
+// futures are held on the stacks of a chain of threads, each of which
+// spawns up to HOLD_LONG + HOLD_MID of them and then the rest of the chain.
+// they are touched only after the end of the chain has spawned its share.
+static const long HOLD_LONG = 896;
+static const long HOLD_MID = 128;
+
+static long hold(long n)
+{
+    madm::future<long> fs[HOLD_LONG];
+    madm::future<mid> gs[HOLD_MID];
+
+    long n_long = (n < HOLD_LONG) ? n : HOLD_LONG;
+    long n_mid = (n - n_long < HOLD_MID) ? n - n_long : HOLD_MID;
+    long n_rest = n - n_long - n_mid;
+
+    for (long i = 0; i < n_long; i++)
+        fs[i].spawn(leaf_long);
+    for (long i = 0; i < n_mid; i++)
+        gs[i].spawn(leaf_mid);
+
+    long sum = 0;
+    if (n_rest > 0) {
+        madm::future<long> rest(hold, n_rest);
+        sum += rest.touch();
+    } else {
+        // all futures are outstanding here
+        madi::future_pool& pool = madi::current_worker().fpool();
+        printf("outstanding: pid %zu: chunks in use = %zu / %zu\n",
+               madm::get_pid(), pool.n_chunks() - pool.n_free_chunks(),
+               pool.n_chunks());
+    }
+
+    for (long i = n_long - 1; i >= 0; i--)
+        sum += fs[i].touch();
+    for (long i = n_mid - 1; i >= 0; i--) {
+        mid m = gs[i].touch();
+        sum += m.v[0] * m.v[3];
+    }
+
+    return sum;
+}
+
+template <class F>
+static void measure(const char *name, F f, int width, int depth)
+{
+    double t0 = madm::time();
+
+    madm::future<long> root(f, width, depth);
+    long result = root.touch();
+
+    double t1 = madm::time();
+
+    double expected = 1.0;
+    for (int i = 0; i < depth; i++)
+        expected *= width;
+
+    double n_futures = n_nodes(width, depth);
+
+    printf("%s: width = %d, depth = %d, result = %ld (%s), "
+           "futures = %.0f, time = %.6f, futures/s = %.0f\n",
+           name, width, depth, result,
+           ((double)result == expected) ? "ok" : "NG",
+           n_futures, t1 - t0, n_futures / (t1 - t0));
+}
+
+static long n_outstanding_arg(int argc, char **argv)
+{
+    return (argc >= 4) ? atol(argv[3]) : 1000000;
+}
+
+void real_main(int argc, char **argv)
+{
+    int width = (argc >= 2) ? atoi(argv[1]) : 32;
+    int depth = (argc >= 3) ? atoi(argv[2]) : 4;
+    long n_outstanding = n_outstanding_arg(argc, argv);
+
+    if (width <= 0 || depth <= 0 || n_outstanding < 0) {
+        if (madm::get_pid() == 0)
+            fprintf(stderr, "usage: %s [width [depth [n_outstanding]]]\n",
+                    argv[0]);
+        return;
+    }
+
+    if (madm::get_pid() == 0) {
+        printf("np = %zu, future_pool_size = %zu, future_chunk_size = %zu\n",
+               madm::get_n_procs(), madi::uth_options.future_pool_size,
+               madi::uth_options.future_chunk_size);
+
+        measure("long", tree_long, width, depth);
+        measure("big ", tree_big, width, depth - (depth > 1 ? 1 : 0));
+
+        if (n_outstanding > 0) {
+            double t0 = madm::time();
+
+            madm::future<long> root(hold, n_outstanding);
+            long result = root.touch();
+
+            double t1 = madm::time();
+
+            printf("outstanding: futures = %ld, result = %ld (%s), "
+                   "time = %.6f\n",
+                   n_outstanding, result,
+                   (result == n_outstanding) ? "ok" : "NG", t1 - t0);
+        }
+    }
+
+    madm::barrier();
+
+    madi::future_pool& pool = madi::current_worker().fpool();
+    printf("pid %zu: free chunks = %zu / %zu\n",
+           madm::get_pid(), pool.n_free_chunks(), pool.n_chunks());
+}
+
+int main(int argc, char **argv)
+{
+    // the chain may not be stolen at all, so the pool and the stack of
+    // each process are made large enough for all outstanding futures
+    // (64 bytes bound both entry sizes, and 20 bytes a future and its
+    // share of a frame of hold), unless they are set explicitly
+    long n_outstanding = n_outstanding_arg(argc, argv);
+    if (n_outstanding > 0) {
+        char buf[32];
+
+        snprintf(buf, sizeof(buf), "%ld", n_outstanding * 64 + (1L << 20));
+        setenv("MADM_FUTURE_POOL_SIZE", buf, 0);
+
+        snprintf(buf, sizeof(buf), "%ld",
+                 (((n_outstanding * 20) >> 20) + 2) << 20);
+        setenv("MADM_STACK_SIZE", buf, 0);
+    }
+
+    madm::start(real_main, argc, argv);
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include <uth.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// task_group and reducer test.
+//
+// every node of a `width'-ary tree of depth `depth' spawns its children
+// into a task_group in two rounds, and waits for each round, so a group
+// is reused after wait(). the leaves spin for `usec' microseconds, so
+// children stolen by other processes decrement the join counter remotely
+// while the parent sleeps in wait() until the last of them wakes it up.
+//
+// instead of returning values, the tasks update reducers: one at
+// namespace scope, and two constructed in real_main after startup. the
+// tree runs `n_runs' times, and after each madm::barrier every process
+// checks the combined values, which accumulate over the runs.
+
+static madm::reducer<madm::reduce_sum<long> > g_leaves;
+static madm::reducer<madm::reduce_sum<long> > *g_nodes = NULL;
+static madm::reducer<madm::reduce_max<long> > *g_max_leaf = NULL;
+
+// leaves run on this process
+static long g_leaves_here = 0;
+
+static void spin(double usec)
+{
+    double t0 = madm::time();
+    while ((madm::time() - t0) * 1e6 < usec)
+        ;
+}
+
+static void node(int width, int depth, long id, double usec)
+{
+    g_nodes->update(1);
+
+    if (depth == 0) {
+        spin(usec);
+
+        g_leaves.update(1);
+        g_max_leaf->update(id);
+        g_leaves_here += 1;
+        return;
+    }
+
+    madm::task_group tg;
+    int half = width / 2;
+
+    for (int i = 0; i < half; i++)
+        tg.spawn(node, width, depth - 1, id * width + i, usec);
+    tg.wait();
+
+    for (int i = half; i < width; i++)
+        tg.spawn(node, width, depth - 1, id * width + i, usec);
+    tg.wait();
+}
+
+void real_main(int argc, char **argv)
+{
+    int width = (argc >= 2) ? atoi(argv[1]) : 8;
+    int depth = (argc >= 3) ? atoi(argv[2]) : 4;
+    double usec = (argc >= 4) ? atof(argv[3]) : 20.0;
+    int n_runs = (argc >= 5) ? atoi(argv[4]) : 2;
+
+    if (width <= 0 || depth < 0 || usec < 0.0 || n_runs <= 0) {
+        if (madm::get_pid() == 0)
+            fprintf(stderr,
+                    "usage: %s [width [depth [usec [n_runs]]]]\n", argv[0]);
+        return;
+    }
+
+    // every process constructs them before the barrier which combines
+    // them first
+    g_nodes = new madm::reducer<madm::reduce_sum<long> >();
+    g_max_leaf = new madm::reducer<madm::reduce_max<long> >();
+
+    long n_leaves = 1, n_nodes = 1;
+    for (int i = 0; i < depth; i++) {
+        n_leaves *= width;
+        n_nodes += n_leaves;
+    }
+
+    for (int run = 1; run <= n_runs; run++) {
+        if (madm::get_pid() == 0) {
+            double t0 = madm::time();
+
+            node(width, depth, 0, usec);
+
+            double t1 = madm::time();
+
+            printf("run %d: np = %zu, width = %d, depth = %d, "
+                   "usec = %.1f, time = %.6f\n",
+                   run, madm::get_n_procs(), width, depth, usec, t1 - t0);
+        }
+
+        madm::barrier();
+
+        long leaves = g_leaves.get();
+        long nodes = g_nodes->get();
+        long max_leaf = g_max_leaf->get();
+
+        bool ok = leaves == run * n_leaves && nodes == run * n_nodes &&
+                  max_leaf == n_leaves - 1;
+
+        printf("pid %zu: run %d: leaves = %ld, nodes = %ld, "
+               "max leaf = %ld (%s), leaves run here = %ld\n",
+               madm::get_pid(), run, leaves, nodes, max_leaf,
+               ok ? "ok" : "NG", g_leaves_here);
+
+        madm::barrier();
+    }
+
+    delete g_max_leaf;
+    delete g_nodes;
+    g_max_leaf = NULL;
+    g_nodes = NULL;
+}
+
+int main(int argc, char **argv)
+{
+    madm::start(real_main, argc, argv);
+    return 0;
+}
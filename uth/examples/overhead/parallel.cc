@@ -0,0 +1,92 @@
+#include <uth.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// parallel_for and parallel_reduce against the hand-written recursive
+// bisection of the bin and nqueens examples, which spawns a future for
+// every iteration. every iteration busy-waits for `loops' clocks.
+// the iterations run by parallel_for are counted with a reducer.
+
+static madm::reducer<madm::reduce_sum<long> > g_iters;
+
+static long busy(long loops)
+{
+    long t = madm::tick();
+    while (madm::tick() - t < loops)
+        ;
+    return 1;
+}
+
+static long rec_sum(long begin, long end, long loops)
+{
+    if (end - begin == 1)
+        return busy(loops);
+
+    long mid = begin + (end - begin) / 2;
+
+    madm::future<long> lower(rec_sum, begin, mid, loops);
+    long upper = rec_sum(mid, end, loops);
+
+    return lower.touch() + upper;
+}
+
+static void report(const char *name, long n, long result, double t)
+{
+    printf("%-22s result = %ld (%s), time = %.6f, iters/s = %.0f\n",
+           name, result, (result == n) ? "ok" : "NG", t, (double)n / t);
+}
+
+void real_main(int argc, char **argv)
+{
+    long n = (argc >= 2) ? atol(argv[1]) : 100000;
+    long loops = (argc >= 3) ? atol(argv[2]) : 1000;
+    long grain = (argc >= 4) ? atol(argv[3]) : 0;
+
+    if (n <= 0 || loops < 0 || grain < 0) {
+        if (madm::get_pid() == 0)
+            fprintf(stderr, "usage: %s [n [loops [grain]]]\n", argv[0]);
+        return;
+    }
+
+    double t_for = 0.0;
+
+    if (madm::get_pid() == 0) {
+        printf("np = %zu, n = %ld, loops = %ld, grain = %ld\n",
+               madm::get_n_procs(), n, loops, grain);
+
+        double t0 = madm::time();
+        madm::future<long> f(rec_sum, 0L, n, loops);
+        long r0 = f.touch();
+        double t1 = madm::time();
+        report("hand-written:", n, r0, t1 - t0);
+
+        t0 = madm::time();
+        madm::parallel_for(0L, n, grain,
+                           [=](long) { g_iters.update(busy(loops)); });
+        t1 = madm::time();
+        t_for = t1 - t0;
+    }
+
+    // combines the counts of all processes
+    madm::barrier();
+
+    if (madm::get_pid() == 0) {
+        report("parallel_for:", n, g_iters.get(), t_for);
+
+        double t0 = madm::time();
+        long r2 = madm::parallel_reduce(0L, n, grain, 0L,
+            [=](long) { return busy(loops); },
+            [](long x, long y) { return x + y; });
+        double t1 = madm::time();
+        report("parallel_reduce:", n, r2, t1 - t0);
+    }
+
+    madm::barrier();
+}
+
+int main(int argc, char **argv)
+{
+    madm::start(real_main, argc, argv);
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include <uth.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <alloca.h>
+
+// suspend/resume throughput.
+//
+// two threads hand a token back and forth. a thread which does not have
+// the token enters the scheduler, which packs it into a saved_context and
+// resumes the other one, so every handoff is a suspend and a resume.
+// `pad' bytes of extra stack frames are live in the waiting thread to
+// control the size of packed stacks.
+//
+// run with one process (other processes steal the threads away).
+// compare MADM_SCTX_POOL_SIZE=0 (malloc/free) with the default pool.
+
+static volatile int g_turn = 0;
+
+static void __attribute__((noinline)) wait_turn(int me, size_t pad)
+{
+    if (pad > 0) {
+        volatile uint8_t *buf = (volatile uint8_t *)alloca(pad);
+        buf[0] = 0;
+        buf[pad - 1] = 0;
+    }
+
+    while (g_turn != me)
+        madi::current_worker().do_scheduler_work();
+}
+
+static int pingpong(int me, size_t n_handoffs, size_t pad)
+{
+    for (size_t i = 0; i < n_handoffs; i++) {
+        wait_turn(me, pad);
+        g_turn = 1 - me;
+    }
+    return 0;
+}
+
+static int measure(size_t n_handoffs)
+{
+    size_t pads[] = { 0, 1024, 16 * 1024, 64 * 1024 };
+
+    printf("sctx_pool_size = %zu\n", madi::uth_options.sctx_pool_max);
+
+    for (size_t i = 0; i < sizeof(pads) / sizeof(pads[0]); i++) {
+        size_t pad = pads[i];
+
+        g_turn = 0;
+
+        double t0 = madm::time();
+        long c0 = madm::tick();
+
+        madm::future<int> f(pingpong, 1, n_handoffs, pad);
+        pingpong(0, n_handoffs, pad);
+        f.touch();
+
+        long c1 = madm::tick();
+        double t1 = madm::time();
+
+        size_t n_switches = 2 * n_handoffs;
+
+        printf("pad = %6zu, cycles/switch = %8ld, switches/s = %10.0f\n",
+               pad, (c1 - c0) / (long)n_switches, n_switches / (t1 - t0));
+    }
+
+    return 0;
+}
+
+void real_main(int argc, char **argv)
+{
+    size_t n_handoffs = (argc >= 2) ? (size_t)atol(argv[1]) : 100000;
+
+    if (madm::get_n_procs() != 1) {
+        if (madm::get_pid() == 0)
+            fprintf(stderr, "suspend: run with one process\n");
+        return;
+    }
+
+    madm::future<int> f(measure, n_handoffs);
+    f.touch();
+}
+
+int main(int argc, char **argv)
+{
+    madm::start(real_main, argc, argv);
+    return 0;
+}
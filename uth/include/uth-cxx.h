@@ -3,6 +3,8 @@
 
 #include "uth/uth_comm.h"
 #include "uth/uth_options.h"
+#include "uth/reducer.h"
+#include "uth/steal_stats.h"
 #include <madm_comm.h>
 #include <cstddef>
 
@@ -17,6 +19,7 @@ namespace madm {
     pid_t get_pid();
     size_t get_n_procs();
 
+    // also combines the views of madm::reducer objects (uth/reducer.h)
     void barrier();
 
     void poll();
@@ -24,6 +27,27 @@ namespace madm {
     long tick();
     double time();
 
+    // call f(i) for every i in [begin, end) in parallel. the range is
+    // cut into chunks of grain iterations (0 chooses the grain from the
+    // number of processes), which are spawned by splitting the chunks in
+    // halves, and joined with one counter. f is copied to each task and
+    // may run on any process.
+    template <class Index, class F>
+    void parallel_for(Index begin, Index end, Index grain, F f);
+
+    template <class Index, class F>
+    void parallel_for(Index begin, Index end, F f);
+
+    // combine(... combine(combine(identity, f(begin)), f(begin + 1)) ...,
+    // f(end - 1)) computed in parallel in the same way as parallel_for.
+    // combine must be associative and identity its identity element.
+    // the result of each chunk is stored on the calling process in one
+    // future entry, so the grain is raised if the results do not fit in
+    // MADM_FUTURE_CHUNK_SIZE bytes.
+    template <class Index, class T, class F, class C>
+    T parallel_reduce(Index begin, Index end, Index grain, T identity,
+                      F f, C combine);
+
 }
 
 #include <vector>
@@ -42,19 +66,26 @@ namespace madi {
         long stack_transfer;
         long unlock;
         long resume;
+        long n_entries;
         long tmp;
 
+        long total() const
+        {
+            return empty_check + lock + steal + suspend + stack_transfer
+                 + unlock + resume;
+        }
+
         void print(FILE *fp)
         {
             fprintf(fp,
                     "ctx = %p, frame_size = %6ld, me = %3ld, victim = %3ld, "
                     "empty = %9ld, lock = %9ld, steal = %9ld, "
                     "suspend = %9ld, stack = %9ld, unlock = %9ld, "
-                    "resume = %9ld\n",
+                    "resume = %9ld, n_entries = %3ld\n",
                     ctx, frame_size, me, victim,
                     empty_check, lock, steal,
                     suspend, stack_transfer, unlock,
-                    resume);
+                    resume, n_entries);
         }
     };
 
@@ -65,6 +96,34 @@ namespace madi {
         size_t n_aborted_steals;
         size_t n_failed_steals_lock;
         size_t n_failed_steals_empty;
+        size_t n_remote_steals;
+        size_t n_leapfrog_steals;
+        size_t n_stolen_entries;
+        size_t max_stolen_entries;
+
+        // batches of touched future ids sent to their owners
+        enum { N_RETURN_FLUSH_BINS = 12 };
+        size_t n_return_flushes;
+        size_t n_returned_ids;
+        size_t max_return_flush;
+        size_t return_flush_sizes[N_RETURN_FLUSH_BINS];  // [2^i, 2^(i+1))
+
+        // ready threads moved to the stealable wait queue, and the ones
+        // resumed by another process
+        size_t n_waitq_exports;
+        size_t n_waitq_migrations;
+
+        // clocks idle workers spent between a failed steal and the next
+        // thread they found, parks of idle workers, and terminations of
+        // a phase detected by them (see idle_controller)
+        size_t idle_clocks;
+        size_t n_parks;
+        size_t n_terminations;
+
+        // every steal is aggregated, and the first steals_size steals
+        // are also dumped raw
+        steal_stats steal_stats_;
+        size_t n_dropped_steals;
 
         size_t steals_size;
         size_t steals_idx;
@@ -72,10 +131,30 @@ namespace madi {
 
     public:
         prof()
-            : steals_size(uth_options.profile_enabled ? 16 * 1024 : 1)
+            : max_stack_usage(0)
+            , n_success_steals(0)
+            , n_aborted_steals(0)
+            , n_failed_steals_lock(0)
+            , n_failed_steals_empty(0)
+            , n_remote_steals(0)
+            , n_leapfrog_steals(0)
+            , n_stolen_entries(0)
+            , max_stolen_entries(0)
+            , n_return_flushes(0)
+            , n_returned_ids(0)
+            , max_return_flush(0)
+            , n_waitq_exports(0)
+            , n_waitq_migrations(0)
+            , idle_clocks(0)
+            , n_parks(0)
+            , n_terminations(0)
+            , n_dropped_steals(0)
+            , steals_size(uth_options.profile_enabled ? 16 * 1024 : 1)
             , steals_idx(0)
             , steals(steals_size)
         {
+            memset(return_flush_sizes, 0, sizeof(return_flush_sizes));
+
             // touch
             memset(steals.data(), 0, sizeof(prof_steal_entry) * steals.size());
         }
@@ -91,10 +170,26 @@ namespace madi {
             if (current_steal().suspend != 0)
                 current_steal().print(stderr);
 #endif
-            if (uth_options.profile_enabled)
-                if (steals_idx + 1 < steals_size)
-                    if (current_steal().steal != 0)
-                        steals_idx++;
+            if (!uth_options.profile_enabled)
+                return;
+
+            prof_steal_entry& e = current_steal();
+            if (e.steal == 0)
+                return;
+
+            long clocks[steal_stats::phase_total] = {
+                e.empty_check, e.lock, e.steal, e.suspend,
+                e.stack_transfer, e.unlock, e.resume,
+            };
+            steal_stats_.record(clocks, e.frame_size, e.victim);
+
+            // the last entry is reused once the raw buffer is full
+            if (steals_idx + 1 < steals_size) {
+                steals_idx++;
+            } else {
+                n_dropped_steals += 1;
+                memset(&e, 0, sizeof(e));
+            }
         }
 
         void output()
@@ -125,6 +220,66 @@ namespace madi {
                                    &n_failed_steals_empty,
                                    1, 0, madi::comm::reduce_op_sum);
 
+                size_t all_remote_steals = 0;
+                madi::comm::reduce(&all_remote_steals, &n_remote_steals,
+                                   1, 0, madi::comm::reduce_op_sum);
+
+                size_t all_leapfrog_steals = 0;
+                madi::comm::reduce(&all_leapfrog_steals, &n_leapfrog_steals,
+                                   1, 0, madi::comm::reduce_op_sum);
+
+                size_t all_stolen_entries = 0;
+                madi::comm::reduce(&all_stolen_entries, &n_stolen_entries,
+                                   1, 0, madi::comm::reduce_op_sum);
+
+                size_t all_max_stolen_entries = 0;
+                madi::comm::reduce(&all_max_stolen_entries,
+                                   &max_stolen_entries,
+                                   1, 0, madi::comm::reduce_op_max);
+
+                size_t all_return_flushes = 0;
+                madi::comm::reduce(&all_return_flushes, &n_return_flushes,
+                                   1, 0, madi::comm::reduce_op_sum);
+
+                size_t all_returned_ids = 0;
+                madi::comm::reduce(&all_returned_ids, &n_returned_ids,
+                                   1, 0, madi::comm::reduce_op_sum);
+
+                size_t all_max_return_flush = 0;
+                madi::comm::reduce(&all_max_return_flush, &max_return_flush,
+                                   1, 0, madi::comm::reduce_op_max);
+
+                size_t all_return_flush_sizes[N_RETURN_FLUSH_BINS] = {};
+                madi::comm::reduce(all_return_flush_sizes,
+                                   return_flush_sizes, N_RETURN_FLUSH_BINS,
+                                   0, madi::comm::reduce_op_sum);
+
+                size_t all_waitq_exports = 0;
+                madi::comm::reduce(&all_waitq_exports, &n_waitq_exports,
+                                   1, 0, madi::comm::reduce_op_sum);
+
+                size_t all_waitq_migrations = 0;
+                madi::comm::reduce(&all_waitq_migrations, &n_waitq_migrations,
+                                   1, 0, madi::comm::reduce_op_sum);
+
+                size_t all_idle_clocks = 0;
+                madi::comm::reduce(&all_idle_clocks, &idle_clocks,
+                                   1, 0, madi::comm::reduce_op_sum);
+
+                size_t all_parks = 0;
+                madi::comm::reduce(&all_parks, &n_parks,
+                                   1, 0, madi::comm::reduce_op_sum);
+
+                size_t all_terminations = 0;
+                madi::comm::reduce(&all_terminations, &n_terminations,
+                                   1, 0, madi::comm::reduce_op_sum);
+
+                size_t all_dropped_steals = 0;
+                madi::comm::reduce(&all_dropped_steals, &n_dropped_steals,
+                                   1, 0, madi::comm::reduce_op_sum);
+
+                steal_stats_.output();
+
                 size_t all_failed_steals = all_aborted_steals
                                          + all_failed_steals_lock
                                          + all_failed_steals_empty;
@@ -137,13 +292,49 @@ namespace madi {
                            "n_failed_steals = %zu, \n"
                            "n_aborted_steals = %zu, "
                            "n_failed_steals_lock = %zu "
-                           "n_failed_steals_empty = %zu\n",
+                           "n_failed_steals_empty = %zu\n"
+                           "n_remote_steals = %zu, "
+                           "n_leapfrog_steals = %zu\n"
+                           "n_stolen_entries = %zu, "
+                           "max_stolen_entries = %zu\n",
                            stack_usage,
                            all_steals, all_success_steals,
                            all_failed_steals,
                            all_aborted_steals,
                            all_failed_steals_lock,
-                           all_failed_steals_empty);
+                           all_failed_steals_empty,
+                           all_remote_steals,
+                           all_leapfrog_steals,
+                           all_stolen_entries,
+                           all_max_stolen_entries);
+
+                    printf("n_return_flushes = %zu, n_returned_ids = %zu, "
+                           "max_return_flush = %zu\n"
+                           "return_flush_sizes =",
+                           all_return_flushes, all_returned_ids,
+                           all_max_return_flush);
+                    for (int i = 0; i < N_RETURN_FLUSH_BINS; i++)
+                        printf(" %zu", all_return_flush_sizes[i]);
+                    printf("\n");
+
+                    printf("n_waitq_exports = %zu, "
+                           "n_waitq_migrations = %zu\n",
+                           all_waitq_exports, all_waitq_migrations);
+
+                    // steal attempts per million idle clocks
+                    double steal_rate = (all_idle_clocks > 0)
+                        ? (double)all_steals * 1e6 / (double)all_idle_clocks
+                        : 0.0;
+
+                    printf("idle_clocks = %zu, steal_rate = %.3f /Mclock, "
+                           "n_parks = %zu, n_terminations = %zu\n",
+                           all_idle_clocks, steal_rate,
+                           all_parks, all_terminations);
+
+                    printf("steal latency breakdown written to "
+                           "steal_stats.json, steal_hist.csv and "
+                           "steal_matrix.csv (%zu steals not in "
+                           "steal.*.out)\n", all_dropped_steals);
                 }
 
                 char fname[1024];
@@ -165,6 +356,7 @@ namespace madi {
 }
 
 #include "uth/future-inl.h"
+#include "uth/parallel-inl.h"
 #include "uth/uth-inl.h"
 #include "uth/debug.h"
 
@@ -5,143 +5,135 @@
 #include "uth_comm-inl.h"
 #include "uni/worker-inl.h"
 #include <madm/threadsafe.h>
+#include <algorithm>
+#include <cstring>
 
 namespace madi {
 
-    inline dist_spinlock::dist_spinlock(uth_comm& c) :
+    inline dist_ring::dist_ring(uth_comm& c, long size) :
         c_(c),
-        locks_(NULL)
+        size_(size),
+        tails_(NULL),
+        heads_(NULL),
+        slots_(NULL),
+        cached_heads_(),
+        staging_()
     {
         madi::pid_t me = c.get_pid();
 
-        locks_ = (int **)c_.malloc_shared(sizeof(int));
-        *locks_[me] = 0;
-    }
+        // the index of a slot is taken by a bit mask
+        MADI_ASSERT(size > 0 && (size & (size - 1)) == 0);
 
-    inline dist_spinlock::~dist_spinlock()
-    {
-        c_.free_shared((void **)locks_);
-    }
+        tails_ = (long **)c_.malloc_shared(sizeof(long));
+        heads_ = (long **)c_.malloc_shared(sizeof(long));
+        slots_ = (slot **)c_.malloc_shared(sizeof(slot) * size);
 
-    inline bool dist_spinlock::trylock(madi::pid_t target)
-    {
-        int *lock = locks_[target];
-        int v = c_.fetch_and_add(lock, 1, target);
-        return (v == 0);
-    }
+        *tails_[me] = 0;
+        *heads_[me] = 0;
 
-    inline void dist_spinlock::lock(madi::pid_t target)
-    {
-        while (!trylock(target))
-            MADI_UTH_COMM_POLL();
-    }
+        for (long i = 0; i < size; i++) {
+            slots_[me][i].data = 0;
+            slots_[me][i].check = 0;
+        }
 
-    inline void dist_spinlock::unlock(madi::pid_t target)
-    {
-        int *lock = locks_[target];
-        c_.put_value(lock, 0, target);
+        cached_heads_.resize(c.get_n_procs(), 0);
     }
 
-    template <class T>
-    dist_pool<T>::dist_pool(uth_comm& c, int size) :
-        c_(c),
-        size_(size),
-        locks_(c),
-        idxes_(NULL),
-        data_(NULL)
+    inline dist_ring::~dist_ring()
     {
-        madi::pid_t me = c.get_pid();
-
-        idxes_ = (int **)c_.malloc_shared(sizeof(int));
-        data_ = (T **)c_.malloc_shared(sizeof(T) * size);
-
-        *idxes_[me] = 0;
+        c_.free_shared((void **)tails_);
+        c_.free_shared((void **)heads_);
+        c_.free_shared((void **)slots_);
     }
 
-    template <class T>
-    dist_pool<T>::~dist_pool()
+    inline uint64_t dist_ring::slot_check(uint64_t data, long idx)
     {
-        c_.free_shared((void **)idxes_);
-        c_.free_shared((void **)data_);
+        // a slot written in a previous round, or partially written, does
+        // not match. never 0, which means empty.
+        uint64_t x = data ^ ((uint64_t)idx * 0x9e3779b97f4a7c15UL);
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9UL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebUL;
+        x = x ^ (x >> 31);
+        return x | 1;
     }
 
-    template <class T>
-    bool dist_pool<T>::empty(madi::pid_t target)
+    inline bool dist_ring::has_room(madi::pid_t target, long tail, long n)
     {
-        madi::pid_t me = c_.get_pid();
-
-        int *idx_ptr = idxes_[target];
-
-        int idx;
-        if (target == me) {
-            idx = *idx_ptr;
-        } else {
-            idx = c_.get_value(idx_ptr, target);
-        }
+        if (tail + n <= cached_heads_[target] + size_)
+            return true;
 
-        MADI_ASSERT(0 <= idx && idx < size_);
+        cached_heads_[target] = c_.get_value(heads_[target], target);
 
-        return idx == 0;
+        return tail + n <= cached_heads_[target] + size_;
     }
 
-    template <class T>
-    bool dist_pool<T>::push_remote(T& v, madi::pid_t target)
+    template <class F>
+    void dist_ring::push_remote(const uint64_t *data, long n,
+                                madi::pid_t target, F poll)
     {
-        locks_.lock(target);
+        MADI_ASSERT(0 < n && n <= size_);
 
-        int *idx_ptr = idxes_[target];
-        int idx = c_.fetch_and_add(idx_ptr, 1, target);
+        long tail = c_.fetch_and_add(tails_[target], n, target);
 
-        MADI_ASSERT(0 <= idx && idx < size_);
+        // the owner may wait for a push of this process to free the
+        // slots, so this process keeps draining its own ring
+        while (!has_room(target, tail, n)) {
+            poll();
+            MADI_UTH_COMM_POLL();
+        }
 
-        bool success;
-        if (idx < size_) {
-            T *buf = data_[target] + idx;
+        staging_.resize(n);
+        for (long i = 0; i < n; i++) {
+            staging_[i].data = data[i];
+            staging_[i].check = slot_check(data[i], tail + i);
+        }
 
-            // v is on a stack registered for RDMA
-            c_.put_buffered(buf, &v, sizeof(T), target);
+        long mask = size_ - 1;
+        long begin = tail & mask;
+        long n_first = std::min(n, size_ - begin);
 
-            success = true;
-        } else {
-            c_.put_value(idx_ptr, idx, target);
-            success = false;
-        }
+        slot *slots = slots_[target];
+        c_.put_buffered(slots + begin, staging_.data(),
+                        sizeof(slot) * n_first, target);
 
-        locks_.unlock(target);
-        return success;
+        if (n_first < n)
+            c_.put_buffered(slots, staging_.data() + n_first,
+                            sizeof(slot) * (n - n_first), target);
     }
 
-    template <class T>
-    void dist_pool<T>::begin_pop_local()
+    inline bool dist_ring::empty_local()
     {
-        madi::pid_t target = c_.get_pid();
-        locks_.lock(target);
-    }
+        madi::pid_t me = c_.get_pid();
 
-    template <class T>
-    void dist_pool<T>::end_pop_local()
-    {
-        madi::pid_t target = c_.get_pid();
-        locks_.unlock(target);
+        long head = *heads_[me];
+        volatile slot *s = slots_[me] + (head & (size_ - 1));
+
+        return s->check == 0;
     }
 
-    template <class T>
-    bool dist_pool<T>::pop_local(T *buf)
+    inline bool dist_ring::pop_local(uint64_t *data)
     {
-        madi::pid_t target = c_.get_pid();
+        madi::pid_t me = c_.get_pid();
 
-        int current_idx = *idxes_[target];
+        long head = *heads_[me];
+        volatile slot *s = slots_[me] + (head & (size_ - 1));
 
-        MADI_ASSERT(0 <= current_idx && current_idx < size_);
+        uint64_t check = s->check;
+        if (check == 0)
+            return false;
+
+        comm::threadsafe::rbarrier();
 
-        if (current_idx == 0)
+        uint64_t d = s->data;
+        if (check != slot_check(d, head))
             return false;
 
-        int idx = current_idx - 1;
-        T *src = data_[target] + idx;
-        memcpy(buf, src, sizeof(T));
+        *data = d;
 
-        *idxes_[target] -= 1;
+        // the slot is cleared before producers see the new head
+        s->check = 0;
+        comm::threadsafe::wbarrier();
+        *(volatile long *)heads_[me] = head + 1;
 
         return true;
     }
@@ -152,37 +144,97 @@ namespace madi {
     }
 
     inline future_pool::future_pool() :
-        ptr_(0), buf_size_(0), remote_bufs_(NULL), retpools_(NULL)
+        buf_size_(0), chunk_bits_(0), remote_bufs_(NULL), bufs_(),
+        chunks_(), free_chunks_(), retrings_(NULL), return_batch_(0),
+        return_batches_(), n_batched_returns_(0), waiters_(),
+        free_waiter_ids_()
     {
     }
     inline future_pool::~future_pool()
     {
     }
 
-    inline void future_pool::initialize(uth_comm& c, size_t buf_size)
+    inline void future_pool::initialize(uth_comm& c, size_t buf_size,
+                                        size_t chunk_size)
     {
-        int retpool_size = 16 * 1024;
+        long retring_size = 16 * 1024;
 
-        ptr_ = 0;
         buf_size_ = (int)buf_size;
+        chunk_bits_ = (int)index_of_size(chunk_size);
+
+        MADI_ASSERT(chunk_bits_ <= MAX_CHUNK_BITS);
+        MADI_ASSERT(buf_size % chunk_size == 0);
+
+        // RDMA registration is collective, so the whole buffer is
+        // allocated here and chunks are handed out on demand.
+        remote_bufs_ = (uint8_t **)c.malloc_shared(buf_size + chunk_size);
+        retrings_ = new dist_ring(c, retring_size);
+
+        size_t n_procs = c.get_n_procs();
+        bufs_.resize(n_procs);
+
+        // a batch and a message which carries it fit in a ring
+        return_batch_ = std::min(madi::uth_options.future_return_batch,
+                                 (size_t)retring_size - 1);
+        return_batches_.resize(n_procs);
+        for (size_t i = 0; i < n_procs; i++) {
+            return_batches_[i].clear();
+            return_batches_[i].reserve(return_batch_ + 1);
+        }
+        n_batched_returns_ = 0;
 
-        remote_bufs_ = (uint8_t **)c.malloc_shared(buf_size);
-        retpools_ = new dist_pool<retpool_entry>(c, retpool_size);
+        for (size_t i = 0; i < n_procs; i++) {
+            uintptr_t addr = (uintptr_t)remote_bufs_[i];
+            addr = (addr + chunk_size - 1) & ~(uintptr_t)(chunk_size - 1);
+            bufs_[i] = (uint8_t *)addr;
+        }
+
+        size_t n_chunks = buf_size >> chunk_bits_;
+
+        chunks_.resize(n_chunks);
+        free_chunks_.clear();
+
+        for (size_t i = 0; i < n_chunks; i++) {
+            chunk& ch = chunks_[i];
+            ch.size_class = -1;
+            ch.ptr = 0;
+            ch.n_live = 0;
+            ch.partial = false;
+            ch.prev = -1;
+            ch.next = -1;
+
+            // pop chunks from the beginning of the buffer first
+            free_chunks_.push_back((int)(n_chunks - 1 - i));
+        }
+
+        for (size_t i = 0; i <= MAX_CHUNK_BITS; i++) {
+            current_chunks_[i] = -1;
+            partial_chunks_[i] = -1;
+        }
     }
 
     inline void future_pool::finalize(uth_comm& c)
     {
         c.free_shared((void **)remote_bufs_);
 
-        for (size_t i = 0; i < MAX_ENTRY_BITS; i++)
-            id_pools_[i].clear();
+        bufs_.clear();
+        chunks_.clear();
+        free_chunks_.clear();
+
+        delete retrings_;
 
-        delete retpools_;
+        // ids which have not been returned are discarded with the buffers
+        return_batches_.clear();
+        n_batched_returns_ = 0;
+
+        MADI_ASSERT(waiters_.size() == free_waiter_ids_.size());
+        waiters_.clear();
+        free_waiter_ids_.clear();
 
-        ptr_ = 0;
         buf_size_ = 0;
+        chunk_bits_ = 0;
         remote_bufs_ = NULL;
-        retpools_ = NULL;
+        retrings_ = NULL;
     }
 
     template <class T>
@@ -191,61 +243,334 @@ namespace madi {
         uth_comm& c = madi::proc().com();
         madi::pid_t me = c.get_pid();
 
-        entry<T> *e = (entry<T> *)(remote_bufs_[me] + id);
+        entry<T> *e = (entry<T> *)(bufs_[me] + id);
 
-        e->done = 0;
+        e->waiter = 0;
+        e->runner = (long)me;
+        e->check = 0;
     }
 
-    inline void future_pool::move_back_returned_ids()
+    inline void future_pool::link_partial(int c)
     {
-        retpools_->begin_pop_local();
+        chunk& ch = chunks_[c];
+        int head = partial_chunks_[ch.size_class];
 
-        size_t count = 0;
-        retpool_entry entry;
-        while (retpools_->pop_local(&entry)) {
-            size_t idx = index_of_size(entry.size);
-            id_pools_[idx].push_back(entry.id);
+        ch.partial = true;
+        ch.prev = -1;
+        ch.next = head;
+
+        if (head >= 0)
+            chunks_[head].prev = c;
+
+        partial_chunks_[ch.size_class] = c;
+    }
+
+    inline void future_pool::unlink_partial(int c)
+    {
+        chunk& ch = chunks_[c];
+
+        if (ch.prev >= 0)
+            chunks_[ch.prev].next = ch.next;
+        else
+            partial_chunks_[ch.size_class] = ch.next;
+
+        if (ch.next >= 0)
+            chunks_[ch.next].prev = ch.prev;
+
+        ch.partial = false;
+        ch.prev = -1;
+        ch.next = -1;
+    }
+
+    inline int future_pool::next_chunk(int size_class)
+    {
+        // prefer a chunk of the size class with returned entries
+        int c = partial_chunks_[size_class];
+
+        if (c >= 0) {
+            unlink_partial(c);
+        } else if (!free_chunks_.empty()) {
+            c = free_chunks_.back();
+            free_chunks_.pop_back();
+
+            chunk& ch = chunks_[c];
+            ch.size_class = size_class;
+            ch.ptr = 0;
+            ch.n_live = 0;
+        } else {
+            MADI_DIE("future pool overflow (%d bytes are in use; "
+                     "increase MADM_FUTURE_POOL_SIZE)", buf_size_);
+        }
+
+        current_chunks_[size_class] = c;
+        return c;
+    }
+
+    // called when the future `id' of this process has been touched
+    inline void future_pool::put_back(int id)
+    {
+        MADI_ASSERT(0 <= id && id < buf_size_);
 
-            count += 1;
+        int c = id >> chunk_bits_;
+        int offset = id & ((1 << chunk_bits_) - 1);
+
+        chunk& ch = chunks_[c];
+        int size_class = ch.size_class;
+
+        MADI_ASSERT(size_class >= 0);
+        MADI_ASSERT(ch.n_live > 0);
+
+        ch.n_live -= 1;
+
+        if (ch.n_live == 0) {
+            ch.ptr = 0;
+            ch.free_offsets.clear();
+
+            if (c != current_chunks_[size_class]) {
+                // the chunk drained; any size class can reuse it
+                if (ch.partial)
+                    unlink_partial(c);
+
+                ch.size_class = -1;
+                free_chunks_.push_back(c);
+            }
+        } else {
+            ch.free_offsets.push_back(offset);
+
+            if (c != current_chunks_[size_class] && !ch.partial)
+                link_partial(c);
         }
+    }
+
+    inline uint64_t future_pool::pack_return(const retpool_entry& rpentry)
+    {
+        // kind (2 bits), id (31 bits), size (31 bits)
+        return ((uint64_t)rpentry.kind << 62) |
+               ((uint64_t)rpentry.id << 31) |
+               (uint64_t)rpentry.size;
+    }
+
+    inline future_pool::retpool_entry
+    future_pool::unpack_return(uint64_t data)
+    {
+        retpool_entry rpentry;
+        rpentry.kind = (int)(data >> 62);
+        rpentry.id = (int)((data >> 31) & 0x7fffffffUL);
+        rpentry.size = (int)(data & 0x7fffffffUL);
+        return rpentry;
+    }
+
+    inline void future_pool::move_back_returned_ids()
+    {
+        size_t count = 0;
+        uint64_t data;
+        while (retrings_->pop_local(&data)) {
+            retpool_entry entry = unpack_return(data);
 
-        retpools_->end_pop_local();
+            if (entry.kind == RETPOOL_WAKE) {
+                resume_waiter(entry.id);
+            } else {
+                put_back(entry.id);
+                count += 1;
+            }
+        }
 
         MADI_DPUTSB1("move back returned future ids: %zu", count);
     }
 
+    inline void future_pool::push_return(retpool_entry& rpentry,
+                                         madi::pid_t target)
+    {
+        uint64_t data = pack_return(rpentry);
+
+        if (rpentry.kind != RETPOOL_ID) {
+            // a thread waits for the message; send it now together with
+            // the ids batched for the target
+            flush_returns(target, &data);
+            return;
+        }
+
+        std::vector<uint64_t>& batch = return_batches_[target];
+        batch.push_back(data);
+        n_batched_returns_ += 1;
+
+        MADI_DPUTSR1("batch future %d to return ring(%zu)",
+                     rpentry.id, target);
+
+        if (batch.size() >= return_batch_)
+            flush_returns(target, NULL);
+    }
+
+    inline void future_pool::flush_returns(madi::pid_t target,
+                                           const uint64_t *extra)
+    {
+        std::vector<uint64_t>& batch = return_batches_[target];
+
+        size_t n_ids = batch.size();
+        if (extra != NULL)
+            batch.push_back(*extra);
+
+        if (batch.empty())
+            return;
+
+        retrings_->push_remote(batch.data(), (long)batch.size(), target,
+                               [this] { move_back_returned_ids(); });
+
+        if (n_ids > 0) {
+            size_t bin = 0;
+            while (bin + 1 < prof::N_RETURN_FLUSH_BINS &&
+                   (2UL << bin) <= n_ids)
+                bin++;
+
+            g_prof->n_return_flushes += 1;
+            g_prof->n_returned_ids += n_ids;
+            g_prof->max_return_flush =
+                std::max(g_prof->max_return_flush, n_ids);
+            g_prof->return_flush_sizes[bin] += 1;
+        }
+
+        n_batched_returns_ -= n_ids;
+        batch.clear();
+    }
+
+    // send all batched ids, when this process has nothing to do
+    inline void future_pool::flush_returns()
+    {
+        if (n_batched_returns_ == 0)
+            return;
+
+        for (size_t i = 0; i < return_batches_.size(); i++)
+            if (!return_batches_[i].empty())
+                flush_returns((madi::pid_t)i, NULL);
+    }
+
     template <class T>
     int future_pool::get()
     {
-        madi::pid_t me = madi::proc().com().get_pid();
+        MADI_ASSERT(offsetof(entry<T>, value) == VALUE_OFFSET);
+        MADI_ASSERT(offsetof(entry<T>, check) ==
+                    check_offset(sizeof(T)));
+
+        int id = get_entry(sizeof(entry<T>));
+
+        // the chunk may have been used by another size class
+        reset<T>(id);
+        return id;
+    }
+
+    inline int future_pool::get_array(size_t size)
+    {
+        return get_entry(VALUE_OFFSET + size);
+    }
+
+    inline size_t future_pool::max_array_size() const
+    {
+        return ((size_t)1 << chunk_bits_) - VALUE_OFFSET;
+    }
+
+    inline int future_pool::get_entry(size_t entry_size)
+    {
+        int size_class = (int)index_of_size(entry_size);
 
-        size_t entry_size = sizeof(entry<T>);
-        size_t idx = index_of_size(entry_size);
+        if (size_class > chunk_bits_)
+            MADI_DIE("future value is too large (%zu bytes; "
+                     "increase MADM_FUTURE_CHUNK_SIZE)", entry_size);
 
-        int real_size = 1 << idx;
+        int real_size = 1 << size_class;
+        int chunk_size = 1 << chunk_bits_;
 
-        // move future ids from the return pool to the local pool
-        if (!retpools_->empty(me)) {
+        // move future ids from the return ring to the local pool
+        if (!retrings_->empty_local()) {
             move_back_returned_ids();
         }
 
-        // pop a future id from the local pool
-        if (!id_pools_[idx].empty()) {
-            int id = id_pools_[idx].back();
-            id_pools_[idx].pop_back();
+        int c = current_chunks_[size_class];
+
+        if (c < 0 || (chunks_[c].free_offsets.empty() &&
+                      chunks_[c].ptr + real_size > chunk_size))
+            c = next_chunk(size_class);
+
+        chunk& ch = chunks_[c];
+
+        // reuse a returned entry, or take a new one from the chunk
+        int offset;
+        if (!ch.free_offsets.empty()) {
+            offset = ch.free_offsets.back();
+            ch.free_offsets.pop_back();
+        } else {
+            offset = ch.ptr;
+            ch.ptr += real_size;
+        }
+
+        ch.n_live += 1;
+
+        return (c << chunk_bits_) | offset;
+    }
+
+    inline uint64_t future_pool::value_hash(const void *p, size_t size)
+    {
+        // FNV-1a over 8-byte words. large values are hashed in four
+        // independent lanes so that they do not wait for one multiply
+        // chain. never 0, which means empty.
+        const uint64_t prime = 1099511628211UL;
+        const uint64_t basis = 14695981039346656037UL;
+        const uint8_t *bytes = (const uint8_t *)p;
+
+        uint64_t r = basis;
+        size_t i = 0;
+
+        if (size >= 4 * sizeof(uint64_t)) {
+            uint64_t h[4] = { basis, basis ^ 1, basis ^ 2, basis ^ 3 };
+
+            for (; i + sizeof(h) <= size; i += sizeof(h)) {
+                uint64_t w[4];
+                memcpy(w, bytes + i, sizeof(w));
+                for (int j = 0; j < 4; j++)
+                    h[j] = (h[j] ^ w[j]) * prime;
+            }
 
-            reset<T>(id);
-            return id;
+            r = h[0];
+            for (int j = 1; j < 4; j++)
+                r = (r ^ h[j]) * prime;
         }
 
-        // if pool is empty, allocate a future id from ptr_
-        if (ptr_ + real_size < buf_size_) {
-            int id = ptr_;
-            ptr_ += real_size;
-            return id;
+        for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+            uint64_t w;
+            memcpy(&w, bytes + i, sizeof(w));
+            r = (r ^ w) * prime;
         }
+        for (; i < size; i++)
+            r = (r ^ bytes[i]) * prime;
+
+        return r | 1;
+    }
+
+    // offset of entry<T>::check, computed from sizeof(T)
+    inline size_t future_pool::check_offset(size_t value_size)
+    {
+        return VALUE_OFFSET +
+            ((value_size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1));
+    }
 
-        madi::die("future pool overflow");
+    // the entry is consumed only after the filler has closed the waiter
+    // word, its last access to the entry, so that the filler never closes
+    // the word of an entry reused for another future
+    inline bool future_pool::is_filled(uint8_t *e, size_t value_size)
+    {
+        long waiter = *(volatile long *)(e + WAITER_OFFSET);
+
+        if ((waiter & 1L) == 0)
+            return false;
+
+        comm::threadsafe::rbarrier();
+
+        uint64_t check = *(volatile uint64_t *)(e + check_offset(value_size));
+
+        if (check == 0)
+            return false;
+
+        comm::threadsafe::rbarrier();
+        return check == value_hash(e + VALUE_OFFSET, value_size);
     }
 
     template <class T>
@@ -254,68 +579,370 @@ namespace madi {
         uth_comm& c = madi::proc().com();
         madi::pid_t me = c.get_pid();
 
-        entry<T> *e = (entry<T> *)(remote_bufs_[pid] + id);
+        entry<T> *e = (entry<T> *)(bufs_[pid] + id);
 
         if (pid == me) {
             e->value = value;
+            uint64_t check = value_hash(&e->value, sizeof(T));
             comm::threadsafe::wbarrier();
-            e->done = 1;
+            e->check = check;
+
+            // the fetch-and-add orders the fill before waking up
+            close_waiter(&e->waiter);
+        } else {
+            // one put for both, composed in place in the registered bounce
+            // buffer if it fits. the put completes before the waiter word
+            // is closed, so a woken thread sees the filled entry.
+            size_t size =
+                check_offset(sizeof(T)) + sizeof(uint64_t) - VALUE_OFFSET;
+
+            if (sizeof(entry<T>) <= c.buffer_size()) {
+                entry<T> *buf = (entry<T> *)c.buffer();
+                memcpy(&buf->value, &value, sizeof(T));
+                buf->check = value_hash(&buf->value, sizeof(T));
+
+                c.put(&e->value, &buf->value, size, pid);
+            } else {
+                // entry_buf is on a stack registered for RDMA
+                entry<T> entry_buf;
+                entry_buf.value = value;
+                entry_buf.check = value_hash(&entry_buf.value, sizeof(T));
+
+                c.put_buffered(&e->value, &entry_buf.value, size, pid);
+            }
+
+            close_remote_waiter(&e->waiter, pid);
+        }
+    }
+
+    // a waiting thread is encoded in the waiter word of a future entry as
+    // ((waiter id + 1) << 32 | pid << 1), which is even and never 0.
+    //
+    // the filler closes the word with one fetch-and-add of 1: 0 becomes 1,
+    // and a waiter W becomes W + 1. a closed word is odd, so a later
+    // add_waiter fails its compare-and-swap and the toucher finds the
+    // filled entry.
+
+    // called by the owner after the entry is filled
+    inline void future_pool::close_waiter(long *waiter)
+    {
+        long old_v = comm::threadsafe::fetch_and_add(waiter, 1L);
+
+        if (old_v != 0)
+            wake_up(old_v);
+    }
+
+    // called by a remote filler after the put of the entry completes
+    inline void future_pool::close_remote_waiter(long *waiter,
+                                                 madi::pid_t pid)
+    {
+        uth_comm& c = madi::proc().com();
+
+        long old_v = c.fetch_and_add(waiter, 1L, pid);
+
+        if (old_v != 0)
+            wake_up(old_v);
+    }
+
+    inline void future_pool::wake_up(long waiter)
+    {
+        uth_comm& c = madi::proc().com();
+        madi::pid_t me = c.get_pid();
+
+        madi::pid_t target = (madi::pid_t)((waiter >> 1) & 0x7fffffffL);
+        int waiter_id = (int)(waiter >> 32) - 1;
+
+        if (target == me) {
+            resume_waiter(waiter_id);
         } else {
-            // value is on a stack registered for RDMA
-            c.put_buffered(&e->value, &value, sizeof(value), pid);
-            c.put_value(&e->done, 1, pid);
+            retpool_entry rpentry = { RETPOOL_WAKE, waiter_id, 0 };
+            push_return(rpentry, target);
+        }
+    }
+
+    inline void future_pool::resume_waiter(int waiter_id)
+    {
+        MADI_ASSERT(0 <= waiter_id && (size_t)waiter_id < waiters_.size());
+
+        saved_context *sctx = waiters_[waiter_id];
+        waiters_[waiter_id] = NULL;
+        free_waiter_ids_.push_back(waiter_id);
+
+        MADI_ASSERT(sctx != NULL);
+
+        // the thread can make progress now
+        madi::current_worker().waitq().push_back(sctx);
+    }
+
+    inline bool future_pool::add_waiter(int id, madi::pid_t pid,
+                                        saved_context *sctx)
+    {
+        uth_comm& c = madi::proc().com();
+        madi::pid_t me = c.get_pid();
+
+        int waiter_id;
+        if (!free_waiter_ids_.empty()) {
+            waiter_id = free_waiter_ids_.back();
+            free_waiter_ids_.pop_back();
+        } else {
+            waiter_id = (int)waiters_.size();
+            waiters_.push_back(NULL);
+        }
+
+        long waiter = ((long)(waiter_id + 1) << 32) | ((long)me << 1);
+
+        long *waiter_ptr = (long *)(bufs_[pid] + id + WAITER_OFFSET);
+
+        // fails if the owner has filled the future
+        bool success;
+        if (pid == me)
+            success = comm::threadsafe::compare_and_swap(waiter_ptr, 0L,
+                                                         waiter);
+        else
+            success = c.compare_and_swap(waiter_ptr, 0L, waiter, pid);
+
+        if (!success) {
+            free_waiter_ids_.push_back(waiter_id);
+            return false;
+        }
+
+        waiters_[waiter_id] = sctx;
+
+        return true;
+    }
+
+    inline void future_pool::move_back_woken_threads()
+    {
+        // woken threads are delivered through the return ring
+        if (!retrings_->empty_local())
+            move_back_returned_ids();
+    }
+
+    inline void future_pool::set_runner(long future, madi::pid_t runner)
+    {
+        uth_comm& c = madi::proc().com();
+        madi::pid_t me = c.get_pid();
+
+        int id = (int)(future >> 32);
+        madi::pid_t pid = (madi::pid_t)(future & 0xffffffffL);
+
+        MADI_ASSERT(0 <= id && id < buf_size_);
+
+        long *runner_ptr = (long *)(bufs_[pid] + id + RUNNER_OFFSET);
+
+        if (pid == me)
+            *(volatile long *)runner_ptr = (long)runner;
+        else
+            c.put_value(runner_ptr, (long)runner, pid);
+    }
+
+    inline int future_pool::get_counter(long value)
+    {
+        uth_comm& c = madi::proc().com();
+        madi::pid_t me = c.get_pid();
+
+        int id = get<long>();
+
+        entry<long> *e = (entry<long> *)(bufs_[me] + id);
+        e->value = value;
+
+        return id;
+    }
+
+    inline long future_pool::fetch_and_add_counter(int id, madi::pid_t pid,
+                                                   long value)
+    {
+        uth_comm& c = madi::proc().com();
+
+        MADI_ASSERT(0 <= id && id < buf_size_);
+
+        long *counter = (long *)(bufs_[pid] + id + VALUE_OFFSET);
+
+        // an RDMA atomic also for the owner, because remote threads
+        // update the counter with RDMA atomics
+        return c.fetch_and_add(counter, value, pid);
+    }
+
+    inline void future_pool::max_counter(int id, madi::pid_t pid, long value)
+    {
+        uth_comm& c = madi::proc().com();
+
+        MADI_ASSERT(0 <= id && id < buf_size_);
+
+        long *counter = (long *)(bufs_[pid] + id + VALUE_OFFSET);
+
+        long old = c.fetch_and_add(counter, 0L, pid);
+        while (old < value) {
+            if (c.compare_and_swap(counter, old, value, pid))
+                break;
+            old = c.fetch_and_add(counter, 0L, pid);
+        }
+    }
+
+    inline void future_pool::free_entry(int id, madi::pid_t pid)
+    {
+        uth_comm& c = madi::proc().com();
+
+        if (pid == c.get_pid()) {
+            put_back(id);
+        } else {
+            retpool_entry rpentry = { RETPOOL_ID, id, 0 };
+            push_return(rpentry, pid);
         }
     }
 
     template <class T>
-    bool future_pool::synchronize(int id, madi::pid_t pid, T *value)
+    bool future_pool::synchronize(int id, madi::pid_t pid, T *value,
+                                  madi::pid_t *runner)
     {
         uth_comm& c = madi::proc().com();
         madi::pid_t me = c.get_pid();
 
-        entry<T> *e = (entry<T> *)(remote_bufs_[pid] + id);
+        MADI_ASSERT(0 <= id && id < buf_size_);
+
+        entry<T> *e = (entry<T> *)(bufs_[pid] + id);
 
         entry<T> entry_buf;
         if (pid != me) {
-#if 0
-            // Is this safe in terms of memory ordering???
-            c.get(&entry_buf, e, sizeof(e), pid);
-#else
-            entry_buf.done = c.get_value(&e->done, pid);
-
-            if (entry_buf.done == 1) {
-                // entry_buf is on a stack registered for RDMA
-                c.get_buffered(&entry_buf.value, &e->value,
-                               sizeof(e->value), pid);
-            }
-#endif
+            // entry_buf is on a stack registered for RDMA
+            c.get_buffered(&entry_buf, e,
+                           check_offset(sizeof(T)) + sizeof(uint64_t), pid);
             e = &entry_buf;
         }
 
-        MADI_ASSERT(0 <= id && id < buf_size_);
+        if (!is_filled((uint8_t *)e, sizeof(T))) {
+            *runner = (madi::pid_t)*(volatile long *)&e->runner;
+            return false;
+        }
 
-        if (e->done) {
-            if (pid == me) {
-                size_t idx = index_of_size(sizeof(entry<T>));
-                id_pools_[idx].push_back(id);
-            } else {
-                // return fork-join descriptor to processor pid.
-                retpool_entry rpentry = { id, (int)sizeof(entry<T>) };
-                bool success = retpools_->push_remote(rpentry, pid);
-
-                if (success) {
-                    MADI_DPUTSR1("push future %d to return pool(%zu)",
-                                id, pid);
-                } else {
-                    madi::die("future return pool becomes full");
-                }
+        *value = e->value;
+
+        if (pid == me) {
+            put_back(id);
+        } else {
+            // return fork-join descriptor to processor pid.
+            retpool_entry rpentry = { RETPOOL_ID, id, (int)sizeof(entry<T>) };
+            push_return(rpentry, pid);
+        }
+
+        return true;
+    }
+
+    inline join_counter::join_counter() :
+        id_(-1), pid_(0), span_id_(-1), bspan_id_(-1)
+    {
+    }
+
+    inline void join_counter::create(long value)
+    {
+        madi::worker& w = madi::current_worker();
+
+        id_ = w.fpool().get_counter(value);
+        pid_ = madi::proc().com().get_pid();
+
+        if (w.span().enabled()) {
+            span_id_ = w.fpool().get_counter(0);
+            bspan_id_ = w.fpool().get_counter(0);
+        }
+    }
+
+    template <class F, class... Args>
+    inline void join_counter::start(join_counter j, F f, Args... args)
+    {
+        madi::worker& w0 = madi::current_worker();
+
+        long parent_future = w0.current_future();
+        w0.set_current_future(madi::future_pool::future_word(j.id_, j.pid_));
+
+        f(args...);
+
+        madi::worker *w = &madi::current_worker();
+        madi::future_pool& pool = w->fpool();
+
+        // before the decrement, after which wait() reads the spans
+        if (j.span_id_ != -1) {
+            madi::span_state s = w->span().fold();
+            pool.max_counter(j.span_id_, j.pid_, s.span);
+            pool.max_counter(j.bspan_id_, j.pid_, s.bspan);
+        }
+
+        j.count_down(1);
+
+        // back to the parent, if it has not been stolen
+        w->set_current_future(parent_future);
+    }
+
+    template <class F, class... Args>
+    inline void join_counter::spawn(F f, Args... args)
+    {
+        madi::worker& w = madi::current_worker();
+
+        if (span_id_ == -1) {
+            w.fork(start<F, Args...>, *this, f, args...);
+            return;
+        }
+
+        madi::span_state s = w.span().fold();
+
+        w.fork(start<F, Args...>, *this, f, args...);
+
+        madi::span_profiler& sp = madi::current_worker().span();
+        sp.restore(sp.continuation(s));
+    }
+
+    inline void join_counter::count_down(long value)
+    {
+        madi::future_pool& pool = madi::current_worker().fpool();
+
+        if (pool.fetch_and_add_counter(id_, pid_, -value) == value) {
+            long zero = 0;
+            pool.fill(id_, pid_, zero);
+        }
+    }
+
+    inline void join_counter::wait()
+    {
+        bool blocked = false;
+
+        for (;;) {
+            madi::worker& w = madi::current_worker();
+
+            long value;
+            madi::pid_t runner;
+            if (w.fpool().synchronize(id_, pid_, &value, &runner)) {
+                if (blocked)
+                    w.trace().record(MADI_TRACE_TOUCH_END);
+                break;
+            }
+
+            if (!blocked) {
+                w.trace().record(MADI_TRACE_TOUCH_BEGIN);
+                blocked = true;
             }
- 
-            comm::threadsafe::rbarrier();
-            *value = e->value;
+
+            madi::span_state s = w.span().fold();
+
+            w.do_scheduler_work(id_, pid_, runner);
+
+            madi::current_worker().span().restore(s);
+        }
+
+        if (span_id_ != -1) {
+            madi::worker& w = madi::current_worker();
+
+            madi::span_state s;
+            s.span = w.fpool().fetch_and_add_counter(span_id_, pid_, 0);
+            s.bspan = w.fpool().fetch_and_add_counter(bspan_id_, pid_, 0);
+
+            w.span().join(s);
+
+            w.fpool().free_entry(span_id_, pid_);
+            w.fpool().free_entry(bspan_id_, pid_);
+            span_id_ = -1;
+            bspan_id_ = -1;
         }
 
-        return e->done;
+        id_ = -1;
     }
 }
 
@@ -326,10 +953,39 @@ namespace madm {
     inline void future<T>::start(int future_id, madi::pid_t pid, 
                                  F f, Args... args)
     {
+        madi::worker& w0 = madi::current_worker();
+
+        long parent_future = w0.current_future();
+        w0.set_current_future(madi::future_pool::future_word(future_id, pid));
+
         T value = f(args...);
 
         madi::worker *w = &madi::current_worker();
         w->fpool().fill(future_id, pid, value);
+
+        // back to the parent, if it has not been stolen
+        w->set_current_future(parent_future);
+    }
+
+    template <class T>
+    template <class F, class... Args>
+    inline void future<T>::start_spanned(int future_id, madi::pid_t pid,
+                                         F f, Args... args)
+    {
+        madi::worker& w0 = madi::current_worker();
+
+        long parent_future = w0.current_future();
+        w0.set_current_future(madi::future_pool::future_word(future_id, pid));
+
+        madi::spanned<T> v;
+        v.value = f(args...);
+
+        madi::worker *w = &madi::current_worker();
+        v.state = w->span().fold();
+        w->fpool().fill(future_id, pid, v);
+
+        // back to the parent, if it has not been stolen
+        w->set_current_future(parent_future);
     }
 
     template <class T>
@@ -350,9 +1006,23 @@ namespace madm {
         madi::worker& w = madi::current_worker();
         madi::uth_comm& c = madi::proc().com();
 
-        future_id_ = w.fpool().get<T>();
         pid_ = c.get_pid();
 
+        if (w.span().enabled()) {
+            future_id_ = w.fpool().get<madi::spanned<T> >();
+
+            // the child and the continuation start from the fork
+            madi::span_state s = w.span().fold();
+
+            w.fork(start_spanned<F, Args...>, future_id_, pid_, f, args...);
+
+            madi::span_profiler& sp = madi::current_worker().span();
+            sp.restore(sp.continuation(s));
+            return;
+        }
+
+        future_id_ = w.fpool().get<T>();
+
         w.fork(start<F, Args...>, future_id_, pid_, f, args...);
 //        w.fork(start<T (Args...), Args...>, future_id_, pid_, f, args...);
     }
@@ -360,21 +1030,108 @@ namespace madm {
     template <class T>
     T future<T>::touch()
     {
+        if (madi::current_worker().span().enabled())
+            return touch_spanned();
+
         T value;
+        bool blocked = false;
 
         for (;;) {
             madi::worker& w = madi::current_worker();
             madi::future_pool& pool = w.fpool();
 
-            if (pool.synchronize(future_id_, pid_, &value))
+            madi::pid_t runner;
+            if (pool.synchronize(future_id_, pid_, &value, &runner)) {
+                if (blocked)
+                    w.trace().record(MADI_TRACE_TOUCH_END);
                 break;
+            }
+
+            if (!blocked) {
+                w.trace().record(MADI_TRACE_TOUCH_BEGIN);
+                blocked = true;
+            }
 
-            w.do_scheduler_work();
+            // sleep until the owner of the future wakes this thread up.
+            // meanwhile, steal from the process running the thread which
+            // fills the future (leapfrogging).
+            w.do_scheduler_work(future_id_, pid_, runner);
         }
 
         return value;
     }
 
+    template <class T>
+    T future<T>::touch_spanned()
+    {
+        madi::spanned<T> v;
+        bool blocked = false;
+
+        for (;;) {
+            madi::worker& w = madi::current_worker();
+            madi::future_pool& pool = w.fpool();
+
+            madi::pid_t runner;
+            if (pool.synchronize(future_id_, pid_, &v, &runner)) {
+                if (blocked)
+                    w.trace().record(MADI_TRACE_TOUCH_END);
+                break;
+            }
+
+            if (!blocked) {
+                w.trace().record(MADI_TRACE_TOUCH_BEGIN);
+                blocked = true;
+            }
+
+            // the strand does not advance while it is blocked
+            madi::span_state s = w.span().fold();
+
+            w.do_scheduler_work(future_id_, pid_, runner);
+
+            madi::current_worker().span().restore(s);
+        }
+
+        madi::current_worker().span().join(v.state);
+
+        return v.value;
+    }
+
+    inline task_group::task_group() :
+        counter_(), n_spawned_(0)
+    {
+    }
+
+    inline task_group::~task_group()
+    {
+        MADI_CHECK(!counter_.created());
+    }
+
+    template <class F, class... Args>
+    inline void task_group::spawn(F f, Args... args)
+    {
+        if (!counter_.created()) {
+            counter_.create(bias);
+            n_spawned_ = 0;
+        }
+
+        n_spawned_ += 1;
+
+        MADI_ASSERT(n_spawned_ < bias);
+
+        counter_.spawn(f, args...);
+    }
+
+    inline void task_group::wait()
+    {
+        if (!counter_.created())
+            return;
+
+        counter_.count_down(bias - n_spawned_);
+        counter_.wait();
+
+        n_spawned_ = 0;
+    }
+
  }
 
 #endif
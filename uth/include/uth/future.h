@@ -10,69 +10,133 @@
 namespace madi {
 
     class uth_comm;
+    struct saved_context;
+
+    // a multi-producer, single-consumer ring of 64-bit words on each
+    // process. a producer reserves slots with one fetch-and-add on the
+    // tail of the target and writes them with one put (two at the wrap
+    // around), so pushes from different processes do not serialize on a
+    // lock. each slot carries a check word computed from the data and the
+    // slot index, with which the owner finds the slots that have been
+    // written completely.
+    class dist_ring {
+        struct slot {
+            uint64_t data;
+            uint64_t check;
+        };
 
-    class dist_spinlock {
         uth_comm& c_;
-        int **locks_;
-    public:
-        dist_spinlock(uth_comm& c);
-        ~dist_spinlock();
+        long size_;
+        long **tails_;
+        long **heads_;
+        slot **slots_;
 
-        bool trylock(madi::pid_t target);
-        void lock(madi::pid_t target);
-        void unlock(madi::pid_t unlock);
-    };
+        // the last head read from each target
+        std::vector<long> cached_heads_;
+        std::vector<slot> staging_;
 
-    template <class T>
-    class dist_pool {
-        uth_comm& c_;
-        int size_;
-        dist_spinlock locks_;
-        int **idxes_;
-        T **data_;
+        static uint64_t slot_check(uint64_t data, long idx);
+        bool has_room(madi::pid_t target, long tail, long n);
     public:
-        dist_pool(uth_comm& c, int size);
-        ~dist_pool();
+        dist_ring(uth_comm& c, long size);
+        ~dist_ring();
+
+        long size() const { return size_; }
 
-        bool empty(madi::pid_t target);
+        bool empty_local();
 
-        bool push_remote(T& v, madi::pid_t target);
+        // poll() is called while the ring of the target is full
+        template <class F>
+        void push_remote(const uint64_t *data, long n, madi::pid_t target,
+                         F poll);
 
-        void begin_pop_local();
-        void end_pop_local();
-        bool pop_local(T *buf);
+        bool pop_local(uint64_t *data);
     };
 
+    // future entries live in a per-process RDMA buffer divided into
+    // fixed-size chunks. a chunk holds the entries of one size class and
+    // returns to the free chunk list when all of its futures are touched,
+    // so the buffer can be reused by other size classes. a future id is
+    // ((chunk index << chunk bits) | offset in the chunk), which is also
+    // the byte offset of the entry in the buffer.
     class future_pool {
         MADI_NONCOPYABLE(future_pool);
 
         enum constants {
-            MAX_ENTRY_BITS = 16,
+            MAX_CHUNK_BITS = 22,
+            WAITER_OFFSET = 0,
+            RUNNER_OFFSET = sizeof(long),
+            VALUE_OFFSET = 2 * sizeof(long),
         };
 
+        // a remote fill writes value and check with one put, and a remote
+        // synchronize reads the whole entry with one get. check is 0 until
+        // the entry is filled, and then value_hash(value), which also
+        // detects a get that overlaps with the put.
         template <class T>
         struct entry {
+            long waiter;  // 0: none, even: a waiting thread, odd: closed
+            long runner;  // the process running the thread which fills it
             T value;
-            int done;
+            uint64_t check;
+        };
+
+        struct chunk {
+            int size_class;     // -1 if the chunk is free
+            int ptr;            // entries below ptr have been handed out
+            int n_live;         // # of ids not returned yet
+            bool partial;       // linked in partial_chunks_[size_class]
+            int prev;
+            int next;
+            std::vector<int> free_offsets;
         };
 
-        int ptr_;
         int buf_size_;
+        int chunk_bits_;
         uint8_t **remote_bufs_;
 
-        std::vector<int> id_pools_[MAX_ENTRY_BITS];
+        // remote_bufs_ aligned to the chunk size, so that no entry spans
+        // two RDMA windows
+        std::vector<uint8_t *> bufs_;
+
+        std::vector<chunk> chunks_;
+        std::vector<int> free_chunks_;
+
+        // the chunk each size class allocates from, and the other chunks
+        // of the size class which have returned entries
+        int current_chunks_[MAX_CHUNK_BITS + 1];
+        int partial_chunks_[MAX_CHUNK_BITS + 1];
+
+        // messages to the owner of future entries, or to the process of a
+        // woken waiter
+        enum retpool_kind {
+            RETPOOL_ID,     // a touched future id
+            RETPOOL_WAKE,   // a waiter id whose future has been filled
+        };
 
         struct retpool_entry {
+            int kind;
             int id;
             int size;
         };
 
-        dist_pool<retpool_entry> *retpools_;
+        dist_ring *retrings_;
+
+        // touched future ids of other processes, which are sent to the
+        // owner when return_batch_ ids are accumulated, with a message
+        // of another kind, or when this process becomes idle
+        size_t return_batch_;
+        std::vector<std::vector<uint64_t> > return_batches_;
+        size_t n_batched_returns_;
+
+        // threads which touched unfilled futures on this process
+        std::vector<saved_context *> waiters_;
+        std::vector<int> free_waiter_ids_;
     public:
         future_pool();
         ~future_pool();
 
-        void initialize(uth_comm& c, size_t n_entries);
+        void initialize(uth_comm& c, size_t buf_size, size_t chunk_size);
         void finalize(uth_comm& c);
 
         template <class T>
@@ -82,13 +146,78 @@ namespace madi {
         void fill(int id, madi::pid_t pid, T& value);
 
         template <class T>
-        bool synchronize(int id, madi::pid_t pid, T *value);
+        bool synchronize(int id, madi::pid_t pid, T *value,
+                         madi::pid_t *runner);
+
+        // a future is identified in a word by ((id << 32) | pid), and the
+        // thread which fills it carries the word (-1 for no future).
+        // a thief records itself as the runner of the future of a stolen
+        // thread, from which a thread touching the future steals.
+        static long future_word(int id, madi::pid_t pid)
+        {
+            return ((long)id << 32) | (long)pid;
+        }
+
+        void set_runner(long future, madi::pid_t runner);
+
+        // a join counter is the value of an entry<long>, which is filled
+        // with 0 when the counter reaches zero (see madm::task_group)
+        int get_counter(long value);
+        long fetch_and_add_counter(int id, madi::pid_t pid, long value);
+        void max_counter(int id, madi::pid_t pid, long value);
+
+        // an entry of `size' bytes of raw values, which threads write with
+        // RDMA and which is never filled (see madm::parallel_reduce)
+        int get_array(size_t size);
+        size_t max_array_size() const;
+
+        uint8_t *array_ptr(int id, madi::pid_t pid)
+        {
+            return bufs_[pid] + id + VALUE_OFFSET;
+        }
+
+        // returns an entry which is never filled (a counter or an array)
+        // to its owner
+        void free_entry(int id, madi::pid_t pid);
+
+        bool add_waiter(int id, madi::pid_t pid, saved_context *sctx);
+        void move_back_woken_threads();
+        void flush_returns();
+
+        size_t n_waiters() const
+        {
+            return waiters_.size() - free_waiter_ids_.size();
+        }
+
+        size_t n_free_chunks() const { return free_chunks_.size(); }
+        size_t n_chunks() const { return chunks_.size(); }
 
     private:
         template <class T>
         void reset(int id);
 
+        int get_entry(size_t entry_size);
+        int next_chunk(int size_class);
+        void put_back(int id);
+        void link_partial(int c);
+        void unlink_partial(int c);
+
         void move_back_returned_ids();
+        void push_return(retpool_entry& rpentry, madi::pid_t target);
+        void flush_returns(madi::pid_t target, const uint64_t *extra);
+
+        static uint64_t pack_return(const retpool_entry& rpentry);
+        static retpool_entry unpack_return(uint64_t data);
+
+        static uint64_t value_hash(const void *p, size_t size);
+        static size_t check_offset(size_t value_size);
+
+        bool is_filled(uint8_t *e, size_t value_size);
+        void close_waiter(long *waiter);
+        void close_remote_waiter(long *waiter, madi::pid_t pid);
+
+        void wake_up(long waiter);
+        void resume_waiter(int waiter_id);
     };
 }
 
@@ -103,6 +232,14 @@ namespace madm {
 
         template <class F, class... Args>
         static void start(int future_id, madi::pid_t pid, F f, Args... args);
+
+        // with the work/span profiler, the entry also carries the span
+        // of the thread (see madi::span_profiler)
+        template <class F, class... Args>
+        static void start_spanned(int future_id, madi::pid_t pid,
+                                  F f, Args... args);
+
+        T touch_spanned();
        
     public:
         future();
@@ -115,7 +252,72 @@ namespace madm {
 
         T touch();
     };
-    
+
+}
+
+namespace madi {
+
+    // a join counter in a future entry owned by the process which
+    // creates it. each thread spawned with spawn() decrements it with one
+    // atomic when it finishes, and the one which brings it to zero fills
+    // the entry, on which wait() sleeps as a touch of a future does.
+    // a copy of the object can spawn threads on any process.
+    class join_counter {
+        int id_;            // -1 if not created
+        madi::pid_t pid_;
+
+        // counters of the maximum span and burdened span of the threads
+        // with the work/span profiler, and -1 otherwise
+        int span_id_;
+        int bspan_id_;
+
+        template <class F, class... Args>
+        static void start(join_counter j, F f, Args... args);
+
+    public:
+        join_counter();
+
+        bool created() const { return id_ != -1; }
+
+        void create(long value);
+
+        template <class F, class... Args>
+        void spawn(F f, Args... args);
+
+        void count_down(long value);
+
+        // frees the counter after it reaches zero
+        void wait();
+    };
+
+}
+
+namespace madm {
+
+    // a group of void-returning threads joined at once.
+    //
+    // the group has a join counter created by its first spawn. the
+    // counter starts at a large bias, and wait() subtracts the bias minus
+    // the number of spawned threads, so the counter reaches zero exactly
+    // when the last thread has finished and wait() has been called.
+    class task_group {
+        MADI_NONCOPYABLE(task_group);
+
+        madi::join_counter counter_;
+        long n_spawned_;
+
+        static const long bias = 1L << 48;
+
+    public:
+        task_group();
+        ~task_group();
+
+        template <class F, class... Args>
+        void spawn(F f, Args... args);
+
+        void wait();
+    };
+
 }
 
 #endif
@@ -0,0 +1,197 @@
+#ifndef MADI_PARALLEL_INL_H
+#define MADI_PARALLEL_INL_H
+
+#include "future-inl.h"
+#include "uth_comm-inl.h"
+#include <cstring>
+
+namespace madi {
+
+    // the number of leaves per process when the grain is chosen
+    // automatically, for load balancing
+    const size_t parallel_leaves_per_proc = 16;
+
+    template <class Index>
+    Index parallel_grain(Index begin, Index end, Index grain)
+    {
+        if (grain > 0)
+            return grain;
+
+        size_t n_leaves =
+            parallel_leaves_per_proc * madi::proc().com().get_n_procs();
+        Index g = (Index)((size_t)(end - begin) / n_leaves);
+
+        return (g > 0) ? g : (Index)1;
+    }
+
+    template <class Index>
+    Index parallel_n_chunks(Index begin, Index end, Index grain)
+    {
+        return (end - begin + grain - 1) / grain;
+    }
+
+    // the range is cut into chunks of grain iterations, and a thread
+    // with chunks [k0, k1) spawns the lower half and keeps the upper half
+    // (work-first, so thieves steal the upper half), down to one chunk.
+    // the threads do not join at splits; all of them count down one join
+    // counter, on which the caller waits.
+    template <class Index, class F>
+    void parallel_for_chunks(join_counter j, Index begin, Index end,
+                             Index grain, Index k0, Index k1, F f)
+    {
+        while (k1 - k0 > 1) {
+            Index km = k0 + (k1 - k0) / 2;
+
+            j.spawn(parallel_for_chunks<Index, F>, j, begin, end, grain,
+                    k0, km, f);
+
+            k0 = km;
+        }
+
+        Index b = begin + k0 * grain;
+        Index e = (end - b > grain) ? b + grain : end;
+
+        for (Index i = b; i < e; i++)
+            f(i);
+    }
+
+    // the same as parallel_for_chunks, and the result of chunk k is
+    // stored in element k of the array entry `results' of process pid
+    template <class Index, class T, class F, class C>
+    void parallel_reduce_chunks(join_counter j, int results,
+                                madi::pid_t pid, Index begin, Index end,
+                                Index grain, Index k0, Index k1,
+                                T identity, F f, C combine)
+    {
+        while (k1 - k0 > 1) {
+            Index km = k0 + (k1 - k0) / 2;
+
+            j.spawn(parallel_reduce_chunks<Index, T, F, C>, j, results, pid,
+                    begin, end, grain, k0, km, identity, f, combine);
+
+            k0 = km;
+        }
+
+        Index b = begin + k0 * grain;
+        Index e = (end - b > grain) ? b + grain : end;
+
+        T acc = identity;
+        for (Index i = b; i < e; i++)
+            acc = combine(acc, f(i));
+
+        // f may have moved the thread to another process
+        uth_comm& c = madi::proc().com();
+        uint8_t *slot = madi::current_worker().fpool().array_ptr(results, pid)
+                        + (size_t)k0 * sizeof(T);
+
+        // the put completes before the count down of the thread
+        if (pid == c.get_pid())
+            memcpy(slot, &acc, sizeof(T));
+        else
+            c.put_buffered(slot, &acc, sizeof(T), pid);
+    }
+
+    // combines the results of the chunks in order, reading a remote
+    // array in blocks
+    template <class T, class C>
+    T parallel_combine_results(int results, madi::pid_t pid, size_t n,
+                               T acc, C combine)
+    {
+        enum { block = (sizeof(T) < 1024) ? 1024 / sizeof(T) : 1 };
+
+        uth_comm& c = madi::proc().com();
+        uint8_t *p = madi::current_worker().fpool().array_ptr(results, pid);
+
+        T values[block];
+
+        for (size_t k = 0; k < n; k += block) {
+            size_t m = (n - k < (size_t)block) ? n - k : (size_t)block;
+
+            if (pid == c.get_pid())
+                memcpy(values, p + k * sizeof(T), m * sizeof(T));
+            else
+                c.get_buffered(values, p + k * sizeof(T), m * sizeof(T),
+                               pid);
+
+            for (size_t i = 0; i < m; i++)
+                acc = combine(acc, values[i]);
+        }
+
+        return acc;
+    }
+
+}
+
+namespace madm {
+
+    template <class Index, class F>
+    inline void parallel_for(Index begin, Index end, Index grain, F f)
+    {
+        if (begin >= end)
+            return;
+
+        grain = madi::parallel_grain(begin, end, grain);
+        Index n_chunks = madi::parallel_n_chunks(begin, end, grain);
+
+        // the caller runs a chunk, and the others run in spawned threads
+        madi::join_counter j;
+        j.create((long)n_chunks);
+
+        madi::parallel_for_chunks(j, begin, end, grain, (Index)0, n_chunks,
+                                  f);
+
+        j.count_down(1);
+        j.wait();
+    }
+
+    template <class Index, class F>
+    inline void parallel_for(Index begin, Index end, F f)
+    {
+        parallel_for(begin, end, (Index)0, f);
+    }
+
+    template <class Index, class T, class F, class C>
+    inline T parallel_reduce(Index begin, Index end, Index grain,
+                             T identity, F f, C combine)
+    {
+        if (begin >= end)
+            return identity;
+
+        grain = madi::parallel_grain(begin, end, grain);
+
+        // the results of all chunks fit in one array entry, so a larger
+        // grain is used if necessary
+        madi::future_pool& pool = madi::current_worker().fpool();
+        Index max_chunks = (Index)(pool.max_array_size() / sizeof(T));
+
+        if (max_chunks > 0 &&
+            madi::parallel_n_chunks(begin, end, grain) > max_chunks)
+            grain = (end - begin + max_chunks - 1) / max_chunks;
+
+        Index n_chunks = madi::parallel_n_chunks(begin, end, grain);
+
+        int results = pool.get_array((size_t)n_chunks * sizeof(T));
+        madi::pid_t pid = madi::proc().com().get_pid();
+
+        madi::join_counter j;
+        j.create((long)n_chunks);
+
+        madi::parallel_reduce_chunks(j, results, pid, begin, end, grain,
+                                     (Index)0, n_chunks, identity, f,
+                                     combine);
+
+        j.count_down(1);
+        j.wait();
+
+        T result = madi::parallel_combine_results(results, pid,
+                                                  (size_t)n_chunks,
+                                                  identity, combine);
+
+        madi::current_worker().fpool().free_entry(results, pid);
+
+        return result;
+    }
+
+}
+
+#endif
@@ -19,6 +19,13 @@ namespace madi {
         iso_space ispace_;
         FILE *debug_out_;
 
+        // a process runs exactly one worker. a thread runs at the same
+        // (uni-)address on every process, so a stolen frame is copied to
+        // the address it was pushed at, which is in use by the stack of the
+        // victim in its own process. two workers of a process would steal
+        // frames from each other only if they had disjoint stacks, and a
+        // frame could then never move to the other one. intra-node steals
+        // are made cheap by the hierarchical victim policy instead.
         //std::vector<worker> workers_;
         worker workers_[1];
 
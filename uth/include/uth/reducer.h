@@ -0,0 +1,154 @@
+#ifndef MADI_REDUCER_H
+#define MADI_REDUCER_H
+
+#include "misc.h"
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace madi {
+
+    class uth_comm;
+
+    // a reducer registers itself at construction, and madi::barrier
+    // combines the views of all registered reducers across processes
+    // by their position in the list of reducers. every process must
+    // therefore construct the same reducers in the same order: at
+    // namespace scope, or in the main function of madm::start, which
+    // runs on every process, before the barrier that combines them.
+    // RDMA buffers for the views of reducers constructed after startup
+    // are allocated collectively at that barrier.
+    class reducer_base : noncopyable {
+        reducer_base *prev_;
+        reducer_base *next_;
+
+    public:
+        reducer_base();
+        virtual ~reducer_base();
+
+        reducer_base * next() const { return next_; }
+
+        virtual size_t view_size() const = 0;
+
+        // copy the local view to buf and reset it to the identity
+        virtual void pack_view(void *buf) = 0;
+
+        // combine the view in buf into the value
+        virtual void merge_view(const void *buf) = 0;
+
+        virtual void pack_value(void *buf) const = 0;
+        virtual void unpack_value(const void *buf) = 0;
+    };
+
+    // collective
+    void initialize_reducers(uth_comm& c);
+    void finalize_reducers(uth_comm& c);
+    void combine_reducers(uth_comm& c);
+
+}
+
+namespace madm {
+
+    // monoids for madm::reducer. a monoid defines value_type, identity()
+    // and reduce(left, right), which sets *left to (*left op right).
+
+    template <class T>
+    struct reduce_sum {
+        typedef T value_type;
+        static T identity() { return T(); }
+        static void reduce(T *left, const T& right) { *left += right; }
+    };
+
+    template <class T>
+    struct reduce_min {
+        typedef T value_type;
+        static T identity() { return std::numeric_limits<T>::max(); }
+        static void reduce(T *left, const T& right)
+        {
+            if (right < *left)
+                *left = right;
+        }
+    };
+
+    template <class T>
+    struct reduce_max {
+        typedef T value_type;
+        static T identity() { return std::numeric_limits<T>::lowest(); }
+        static void reduce(T *left, const T& right)
+        {
+            if (*left < right)
+                *left = right;
+        }
+    };
+
+    // an accumulator which tasks update without returning values through
+    // futures. tasks update the view of the process they run on, and
+    // madm::barrier combines the views of all processes into the value,
+    // which every process then reads with get(). since a process runs
+    // one worker and threads switch only at scheduling points, a view
+    // is updated without atomics, and a stolen continuation needs no
+    // merge at join. the views are combined in process order, so the
+    // monoid must be commutative as well as associative.
+    //
+    // every process must construct the same reducers in the same order
+    // (see madi::reducer_base), and value_type is copied with RDMA.
+    // a barrier with reducers costs two more barriers than one without.
+    template <class Monoid>
+    class reducer : madi::reducer_base {
+    public:
+        typedef typename Monoid::value_type value_type;
+
+    private:
+        static_assert(std::is_trivially_copyable<value_type>::value,
+                      "reducer values are copied with RDMA");
+
+        value_type view_;
+        value_type value_;
+
+    public:
+        reducer() :
+            view_(Monoid::identity()), value_(Monoid::identity()) {}
+
+        explicit reducer(const value_type& initial) :
+            view_(Monoid::identity()), value_(initial) {}
+
+        void update(const value_type& x) { Monoid::reduce(&view_, x); }
+
+        value_type& view() { return view_; }
+
+        // the value combined at the last madm::barrier
+        const value_type& get() const { return value_; }
+
+        // the value on pid 0 is the one combined at the next barrier
+        void set(const value_type& x) { value_ = x; }
+
+        size_t view_size() const { return sizeof(value_type); }
+
+        void pack_view(void *buf)
+        {
+            memcpy(buf, &view_, sizeof(value_type));
+            view_ = Monoid::identity();
+        }
+
+        void merge_view(const void *buf)
+        {
+            value_type v;
+            memcpy(&v, buf, sizeof(value_type));
+            Monoid::reduce(&value_, v);
+        }
+
+        void pack_value(void *buf) const
+        {
+            memcpy(buf, &value_, sizeof(value_type));
+        }
+
+        void unpack_value(const void *buf)
+        {
+            memcpy(&value_, buf, sizeof(value_type));
+        }
+    };
+
+}
+
+#endif
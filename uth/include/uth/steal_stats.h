@@ -0,0 +1,324 @@
+#ifndef MADI_STEAL_STATS_H
+#define MADI_STEAL_STATS_H
+
+#include <madm_comm.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace madi {
+
+    // latency breakdown of successful steals (see prof_steal_entry).
+    //
+    // every steal is recorded as it completes into fixed-size histograms,
+    // so no steal is lost on long runs. the histograms, a thief x victim
+    // matrix and a frame size vs stack transfer table are reduced to
+    // pid 0 at finalization and written to steal_stats.json,
+    // steal_hist.csv and steal_matrix.csv.
+    class steal_stats {
+    public:
+        enum phase {
+            phase_empty_check,
+            phase_lock,
+            phase_steal,
+            phase_suspend,
+            phase_stack_transfer,
+            phase_unlock,
+            phase_resume,
+            phase_total,
+            N_PHASES,
+        };
+
+        // log-linear bins of clocks: 4 bins per power of two up to 2^48
+        enum { N_SUB_BITS = 2, N_SUBS = 1 << N_SUB_BITS, N_EXPS = 48,
+               N_BINS = N_SUBS * N_EXPS };
+
+        // bins of frame sizes: [2^i, 2^(i+1)) bytes
+        enum { N_FRAME_BINS = 32 };
+
+    private:
+        size_t n_steals_;
+        size_t hist_[N_PHASES][N_BINS];
+        size_t sum_[N_PHASES];
+        size_t max_[N_PHASES];
+
+        size_t frame_steals_[N_FRAME_BINS];
+        size_t frame_bytes_[N_FRAME_BINS];
+        size_t frame_clocks_[N_FRAME_BINS];
+        size_t frame_max_clocks_[N_FRAME_BINS];
+
+        // the row of this process in the matrix, allocated at the first
+        // steal because the communication layer is initialized after prof
+        std::vector<size_t> victim_steals_;
+        std::vector<size_t> victim_clocks_;
+
+    public:
+        steal_stats() : n_steals_(0)
+        {
+            memset(hist_, 0, sizeof(hist_));
+            memset(sum_, 0, sizeof(sum_));
+            memset(max_, 0, sizeof(max_));
+            memset(frame_steals_, 0, sizeof(frame_steals_));
+            memset(frame_bytes_, 0, sizeof(frame_bytes_));
+            memset(frame_clocks_, 0, sizeof(frame_clocks_));
+            memset(frame_max_clocks_, 0, sizeof(frame_max_clocks_));
+        }
+
+        static const char * phase_name(int p)
+        {
+            static const char *names[N_PHASES] = {
+                "empty_check", "lock", "steal", "suspend",
+                "stack_transfer", "unlock", "resume", "total",
+            };
+            return names[p];
+        }
+
+        static int log2_floor(size_t v)
+        {
+            return (v == 0) ? -1 : 63 - __builtin_clzl(v);
+        }
+
+        static int bin_of(size_t clocks)
+        {
+            if (clocks < N_SUBS)
+                return (int)clocks;
+
+            int e = log2_floor(clocks);
+            int sub = (int)(clocks >> (e - N_SUB_BITS)) & (N_SUBS - 1);
+            return std::min((e - N_SUB_BITS + 1) * N_SUBS + sub,
+                            (int)N_BINS - 1);
+        }
+
+        // the smallest value in the bin
+        static size_t bin_lower(int bin)
+        {
+            if (bin < N_SUBS)
+                return (size_t)bin;
+
+            int e = bin / N_SUBS + N_SUB_BITS - 1;
+            size_t sub = (size_t)(bin % N_SUBS);
+            return (N_SUBS + sub) << (e - N_SUB_BITS);
+        }
+
+        // phase clocks are in the order of enum phase, without the total
+        void record(const long clocks[], long frame_size, long victim)
+        {
+            size_t total = 0;
+
+            for (int p = 0; p < phase_total; p++) {
+                size_t t = (size_t)std::max(clocks[p], 0L);
+                add(p, t);
+                total += t;
+            }
+            add(phase_total, total);
+
+            n_steals_ += 1;
+
+            int fb = std::min(log2_floor((size_t)std::max(frame_size, 1L)),
+                              (int)N_FRAME_BINS - 1);
+            size_t transfer = (size_t)std::max(clocks[phase_stack_transfer],
+                                               0L);
+            frame_steals_[fb] += 1;
+            frame_bytes_[fb] += (size_t)std::max(frame_size, 0L);
+            frame_clocks_[fb] += transfer;
+            frame_max_clocks_[fb] = std::max(frame_max_clocks_[fb], transfer);
+
+            if (victim_steals_.empty()) {
+                victim_steals_.resize(comm::get_n_procs());
+                victim_clocks_.resize(comm::get_n_procs());
+            }
+
+            if (victim >= 0 && (size_t)victim < victim_steals_.size()) {
+                victim_steals_[victim] += 1;
+                victim_clocks_[victim] += total;
+            }
+        }
+
+        // collective
+        void output()
+        {
+            comm::pid_t me = comm::get_pid();
+            size_t n_procs = comm::get_n_procs();
+
+            size_t n_steals = 0;
+            comm::reduce(&n_steals, &n_steals_, 1, 0, comm::reduce_op_sum);
+
+            std::vector<size_t> hist(N_PHASES * N_BINS);
+            comm::reduce(hist.data(), &hist_[0][0], N_PHASES * N_BINS, 0,
+                         comm::reduce_op_sum);
+
+            size_t sum[N_PHASES], max[N_PHASES];
+            comm::reduce(sum, sum_, N_PHASES, 0, comm::reduce_op_sum);
+            comm::reduce(max, max_, N_PHASES, 0, comm::reduce_op_max);
+
+            size_t frame_steals[N_FRAME_BINS], frame_bytes[N_FRAME_BINS];
+            size_t frame_clocks[N_FRAME_BINS], frame_max[N_FRAME_BINS];
+            comm::reduce(frame_steals, frame_steals_, N_FRAME_BINS, 0,
+                         comm::reduce_op_sum);
+            comm::reduce(frame_bytes, frame_bytes_, N_FRAME_BINS, 0,
+                         comm::reduce_op_sum);
+            comm::reduce(frame_clocks, frame_clocks_, N_FRAME_BINS, 0,
+                         comm::reduce_op_sum);
+            comm::reduce(frame_max, frame_max_clocks_, N_FRAME_BINS, 0,
+                         comm::reduce_op_max);
+
+            // each process contributes its own row
+            std::vector<size_t> rows(2 * n_procs * n_procs, 0);
+            std::vector<size_t> matrix(2 * n_procs * n_procs, 0);
+            for (size_t v = 0; v < victim_steals_.size(); v++) {
+                rows[me * n_procs + v] = victim_steals_[v];
+                rows[(n_procs + me) * n_procs + v] = victim_clocks_[v];
+            }
+            comm::reduce(matrix.data(), rows.data(), rows.size(), 0,
+                         comm::reduce_op_sum);
+
+            if (me != 0)
+                return;
+
+            size_t *steals = matrix.data();
+            size_t *clocks = matrix.data() + n_procs * n_procs;
+
+            write_json("steal_stats.json", n_procs, n_steals, hist.data(),
+                       sum, max, frame_steals, frame_bytes, frame_clocks,
+                       frame_max, steals);
+            write_hist_csv("steal_hist.csv", hist.data());
+            write_matrix_csv("steal_matrix.csv", n_procs, steals, clocks);
+        }
+
+    private:
+        void add(int p, size_t t)
+        {
+            hist_[p][bin_of(t)] += 1;
+            sum_[p] += t;
+            max_[p] = std::max(max_[p], t);
+        }
+
+        // an upper bound of the q-quantile, exact within a bin
+        static size_t percentile(const size_t *hist, size_t n, size_t max,
+                                 double q)
+        {
+            if (n == 0)
+                return 0;
+
+            size_t rank = (size_t)(q * (double)n);
+            if (rank >= n)
+                rank = n - 1;
+
+            size_t count = 0;
+            for (int b = 0; b < N_BINS; b++) {
+                count += hist[b];
+                if (count > rank) {
+                    size_t upper = (b + 1 < N_BINS) ? bin_lower(b + 1) - 1
+                                                    : max;
+                    return std::min(upper, max);
+                }
+            }
+            return max;
+        }
+
+        static void write_json(const char *fname, size_t n_procs,
+                               size_t n_steals, const size_t *hist,
+                               const size_t *sum, const size_t *max,
+                               const size_t *frame_steals,
+                               const size_t *frame_bytes,
+                               const size_t *frame_clocks,
+                               const size_t *frame_max,
+                               const size_t *steals)
+        {
+            FILE *fp = fopen(fname, "w");
+            if (fp == NULL)
+                return;
+
+            fprintf(fp, "{\n  \"n_procs\": %zu,\n  \"n_steals\": %zu,\n",
+                    n_procs, n_steals);
+
+            fprintf(fp, "  \"phases\": {\n");
+            for (int p = 0; p < N_PHASES; p++) {
+                const size_t *h = hist + p * N_BINS;
+                double mean = (n_steals > 0)
+                    ? (double)sum[p] / (double)n_steals : 0.0;
+
+                fprintf(fp, "    \"%s\": {\"mean\": %.1f, \"p50\": %zu, "
+                        "\"p90\": %zu, \"p99\": %zu, \"max\": %zu}%s\n",
+                        phase_name(p), mean,
+                        percentile(h, n_steals, max[p], 0.50),
+                        percentile(h, n_steals, max[p], 0.90),
+                        percentile(h, n_steals, max[p], 0.99),
+                        max[p], (p + 1 < N_PHASES) ? "," : "");
+            }
+            fprintf(fp, "  },\n");
+
+            // mean transfer clocks per frame size bin
+            fprintf(fp, "  \"frames\": [");
+            bool first = true;
+            for (int b = 0; b < N_FRAME_BINS; b++) {
+                if (frame_steals[b] == 0)
+                    continue;
+
+                fprintf(fp, "%s\n    {\"min_bytes\": %zu, "
+                        "\"steals\": %zu, \"mean_bytes\": %.1f, "
+                        "\"mean_transfer\": %.1f, \"max_transfer\": %zu}",
+                        first ? "" : ",", (size_t)1 << b, frame_steals[b],
+                        (double)frame_bytes[b] / (double)frame_steals[b],
+                        (double)frame_clocks[b] / (double)frame_steals[b],
+                        frame_max[b]);
+                first = false;
+            }
+            fprintf(fp, "\n  ],\n");
+
+            // steals[thief][victim]
+            fprintf(fp, "  \"victims\": [");
+            for (size_t i = 0; i < n_procs; i++) {
+                fprintf(fp, "%s\n    [", (i > 0) ? "," : "");
+                for (size_t j = 0; j < n_procs; j++)
+                    fprintf(fp, "%s%zu", (j > 0) ? ", " : "",
+                            steals[i * n_procs + j]);
+                fprintf(fp, "]");
+            }
+            fprintf(fp, "\n  ]\n}\n");
+
+            fclose(fp);
+        }
+
+        static void write_hist_csv(const char *fname, const size_t *hist)
+        {
+            FILE *fp = fopen(fname, "w");
+            if (fp == NULL)
+                return;
+
+            fprintf(fp, "phase,min_clocks,count\n");
+            for (int p = 0; p < N_PHASES; p++)
+                for (int b = 0; b < N_BINS; b++)
+                    if (hist[p * N_BINS + b] > 0)
+                        fprintf(fp, "%s,%zu,%zu\n", phase_name(p),
+                                bin_lower(b), hist[p * N_BINS + b]);
+
+            fclose(fp);
+        }
+
+        static void write_matrix_csv(const char *fname, size_t n_procs,
+                                     const size_t *steals,
+                                     const size_t *clocks)
+        {
+            FILE *fp = fopen(fname, "w");
+            if (fp == NULL)
+                return;
+
+            fprintf(fp, "thief,victim,steals,mean_clocks\n");
+            for (size_t i = 0; i < n_procs; i++) {
+                for (size_t j = 0; j < n_procs; j++) {
+                    size_t n = steals[i * n_procs + j];
+                    if (n > 0)
+                        fprintf(fp, "%zu,%zu,%zu,%.1f\n", i, j, n,
+                                (double)clocks[i * n_procs + j] / (double)n);
+                }
+            }
+
+            fclose(fp);
+        }
+    };
+
+}
+
+#endif
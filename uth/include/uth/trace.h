@@ -0,0 +1,184 @@
+#ifndef MADI_TRACE_H
+#define MADI_TRACE_H
+
+#include <stdint.h>
+
+/*
+ * timeline trace of the scheduler of each process (MADM_TRACE=1).
+ *
+ * a process writes trace.%03zu.bin at finalization: a madi_trace_header
+ * followed by n_events madi_trace_events, oldest first. each event marks
+ * the point where the worker starts doing something else, and
+ * uth/tools/uthrun/trace2json converts the files of all processes to
+ * Chrome trace JSON with one track per process.
+ */
+
+#define MADI_TRACE_MAGIC    0x3143525444414d4dULL     /* "MADMTRC1" */
+
+enum madi_trace_type {
+    MADI_TRACE_FORK,            /* a thread spawns a child */
+    MADI_TRACE_DIE,             /* a thread exits and its parent is stolen */
+    MADI_TRACE_SUSPEND,         /* the running thread is switched out */
+    MADI_TRACE_RESUME,          /* a local thread resumes */
+    MADI_TRACE_RESUME_STOLEN,   /* a stolen thread resumes; arg = victim */
+    MADI_TRACE_STEAL,           /* a steal that succeeds starts; arg = victim */
+    MADI_TRACE_IDLE,            /* a round of steals fails */
+    MADI_TRACE_TOUCH_BEGIN,     /* a touched future is not filled yet */
+    MADI_TRACE_TOUCH_END,       /* the touched future is filled */
+    MADI_TRACE_N_TYPES,
+};
+
+struct madi_trace_header {
+    uint64_t magic;
+    uint64_t pid;
+    uint64_t n_procs;
+    uint64_t n_events;
+    uint64_t n_dropped;         /* oldest events overwritten in the ring */
+    int64_t  start_tsc;
+    int64_t  start_ns;          /* CLOCK_REALTIME at start_tsc */
+    double   clocks_per_ns;
+};
+
+struct madi_trace_event {
+    int64_t  tsc;
+    uint32_t type;
+    uint32_t arg;
+};
+
+#ifdef __cplusplus
+
+#include "madi.h"
+#include "uth_options.h"
+#include "debug.h"
+#include <madm_misc.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+namespace madi {
+
+    // a ring buffer of the last uth_options.trace_buf_size events of a
+    // worker. record() is a test of a NULL pointer if tracing is disabled.
+    class trace_recorder {
+        madi_trace_event *events_;
+        size_t mask_;
+        size_t n_events_;
+        bool idle_;
+
+        int64_t start_tsc_;
+        int64_t start_ns_;
+
+    public:
+        trace_recorder() :
+            events_(NULL), mask_(0), n_events_(0), idle_(false),
+            start_tsc_(0), start_ns_(0)
+        {
+        }
+
+        void initialize()
+        {
+            if (!uth_options.trace_enabled)
+                return;
+
+            size_t capacity = 1;
+            while (capacity < uth_options.trace_buf_size)
+                capacity *= 2;
+
+            events_ = (madi_trace_event *)
+                malloc(sizeof(madi_trace_event) * capacity);
+            MADI_CHECK(events_ != NULL);
+
+            mask_ = capacity - 1;
+            n_events_ = 0;
+            idle_ = false;
+
+            start_ns_ = now_ns();
+            start_tsc_ = rdtsc();
+        }
+
+        void finalize(madi::pid_t me, size_t n_procs)
+        {
+            if (events_ == NULL)
+                return;
+
+            int64_t end_ns = now_ns();
+            int64_t end_tsc = rdtsc();
+
+            size_t capacity = mask_ + 1;
+            size_t n = std::min(n_events_, capacity);
+
+            madi_trace_header h;
+            h.magic = MADI_TRACE_MAGIC;
+            h.pid = me;
+            h.n_procs = n_procs;
+            h.n_events = n;
+            h.n_dropped = n_events_ - n;
+            h.start_tsc = start_tsc_;
+            h.start_ns = start_ns_;
+            h.clocks_per_ns = (end_ns > start_ns_)
+                ? (double)(end_tsc - start_tsc_) / (double)(end_ns - start_ns_)
+                : 1.0;
+
+            char fname[1024];
+            sprintf(fname, "trace.%03zu.bin", me);
+
+            FILE *fp = fopen(fname, "wb");
+            if (fp != NULL) {
+                fwrite(&h, sizeof(h), 1, fp);
+                for (size_t i = n_events_ - n; i < n_events_; i++)
+                    fwrite(&events_[i & mask_], sizeof(madi_trace_event),
+                           1, fp);
+                fclose(fp);
+            }
+
+            free(events_);
+            events_ = NULL;
+        }
+
+        void record_at(tsc_t tsc, madi_trace_type type, uint32_t arg = 0)
+        {
+            if (events_ == NULL)
+                return;
+
+            madi_trace_event& e = events_[n_events_ & mask_];
+            e.tsc = tsc;
+            e.type = type;
+            e.arg = arg;
+
+            n_events_ += 1;
+            idle_ = false;
+        }
+
+        void record(madi_trace_type type, uint32_t arg = 0)
+        {
+            if (events_ == NULL)
+                return;
+
+            record_at(rdtsc(), type, arg);
+        }
+
+        // only the first of consecutive failed rounds is recorded
+        void record_idle()
+        {
+            if (events_ == NULL || idle_)
+                return;
+
+            record(MADI_TRACE_IDLE);
+            idle_ = true;
+        }
+
+    private:
+        static int64_t now_ns()
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            return (int64_t)ts.tv_sec * 1000000000L + ts.tv_nsec;
+        }
+    };
+
+}
+
+#endif
+
+#endif
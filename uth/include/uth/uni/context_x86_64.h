@@ -97,6 +97,7 @@ struct saved_context {
     context *ctx;
     uint8_t *stack_top;
     size_t stack_size;
+    long future;
     uint8_t partial_stack[1];
 };
 
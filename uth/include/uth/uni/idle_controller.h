@@ -0,0 +1,191 @@
+#ifndef MADI_UNI_IDLE_CONTROLLER_H
+#define MADI_UNI_IDLE_CONTROLLER_H
+
+#include "../madi.h"
+#include "../uth_options.h"
+#include "../uth_comm.h"
+#include "../debug.h"
+#include "../misc.h"
+#include <algorithm>
+#include <climits>
+
+namespace madi {
+
+    // pacing of steal attempts by an idle worker.
+    //
+    // after a round of steal attempts fails, the next round is delayed by
+    // a random time in [backoff/2, backoff), where backoff doubles from
+    // uth_options.idle_backoff_min up to uth_options.idle_backoff_max
+    // clocks, so that idle processes do not flood the busy ones with
+    // RDMA requests near the end of a phase.
+    //
+    // a worker whose main task waits in madi::barrier, and which has no
+    // other thread at all, parks when its backoff reaches the maximum.
+    // parked workers are counted in a counter on pid 0 (one per barrier
+    // parity), and a parked worker wakes up once per maximum backoff to
+    // look at the counter and to try another round of steals. since
+    // a worker unparks before it steals and only a running thread can
+    // create work, the counter reaching n_procs means that no thread is
+    // left in the phase: every worker stops stealing until the barrier
+    // completes (termination detection).
+    class idle_controller {
+        madi::pid_t me_;
+        size_t n_procs_;
+
+        tsc_t min_backoff_;
+        tsc_t max_backoff_;
+        tsc_t backoff_;         // 0 if the last round did not fail
+        tsc_t next_steal_;
+        tsc_t idle_since_;      // 0 if not idle
+
+        long **counters_;       // # of parked workers per barrier parity
+        int phase_;
+        bool draining_;         // the main task waits in madi::barrier
+        bool parked_;
+        bool terminated_;
+
+    public:
+        idle_controller() :
+            me_(0), n_procs_(0),
+            min_backoff_(0), max_backoff_(0),
+            backoff_(0), next_steal_(0), idle_since_(0),
+            counters_(NULL), phase_(0),
+            draining_(false), parked_(false), terminated_(false)
+        {
+        }
+
+        void initialize(uth_comm& c)
+        {
+            me_ = c.get_pid();
+            n_procs_ = c.get_n_procs();
+            min_backoff_ = (tsc_t)uth_options.idle_backoff_min;
+            max_backoff_ = (tsc_t)uth_options.idle_backoff_max;
+            backoff_ = 0;
+            next_steal_ = 0;
+            idle_since_ = 0;
+
+            // collective; process_do_initialize is followed by a barrier
+            counters_ = (long **)c.malloc_shared(sizeof(long) * 2);
+            counters_[me_][0] = 0;
+            counters_[me_][1] = 0;
+
+            phase_ = 0;
+            draining_ = false;
+            parked_ = false;
+            terminated_ = false;
+        }
+
+        void finalize(uth_comm& c)
+        {
+            c.free_shared((void **)counters_);
+            counters_ = NULL;
+        }
+
+        bool parking_enabled() const
+        {
+            return uth_options.idle_park && n_procs_ > 1
+                && max_backoff_ > 0;
+        }
+
+        // whether the worker may try a round of steals now. the parked
+        // worker which finds termination sets *terminated.
+        bool may_steal(uth_comm& c, bool *terminated)
+        {
+            *terminated = false;
+
+            if (terminated_)
+                return false;
+
+            if (backoff_ == 0)
+                return true;
+
+            if (rdtsc() < next_steal_)
+                return false;
+
+            if (parked_) {
+                long *counter = &counters_[0][phase_];
+
+                if ((size_t)c.get_value(counter, 0) == n_procs_) {
+                    terminated_ = true;
+                    *terminated = true;
+                    return false;
+                }
+
+                c.fetch_and_add(counter, -1, 0);
+                parked_ = false;
+            }
+
+            return true;
+        }
+
+        // a round of steals has failed. returns true if the worker parks.
+        bool notify_failure(uth_comm& c, bool can_park)
+        {
+            tsc_t now = rdtsc();
+
+            if (idle_since_ == 0)
+                idle_since_ = now;
+
+            if (max_backoff_ == 0)
+                return false;
+
+            backoff_ = (backoff_ == 0)
+                ? std::max(min_backoff_, (tsc_t)1)
+                : std::min(backoff_ * 2, max_backoff_);
+
+            tsc_t half = backoff_ / 2;
+            tsc_t jitter = (half > 0) ? (tsc_t)random_int((int)std::min(
+                half, (tsc_t)INT_MAX)) : 0;
+            next_steal_ = now + half + jitter;
+
+            if (backoff_ < max_backoff_ || parked_ || !can_park
+                || !draining_ || !parking_enabled())
+                return false;
+
+            c.fetch_and_add(&counters_[0][phase_], 1, 0);
+            parked_ = true;
+            return true;
+        }
+
+        // the worker found a thread to run. returns the idle clocks.
+        tsc_t notify_work(uth_comm& c)
+        {
+            MADI_ASSERT(!terminated_);
+
+            if (parked_) {
+                c.fetch_and_add(&counters_[0][phase_], -1, 0);
+                parked_ = false;
+            }
+
+            backoff_ = 0;
+            next_steal_ = 0;
+
+            if (idle_since_ == 0)
+                return 0;
+
+            tsc_t t = rdtsc() - idle_since_;
+            idle_since_ = 0;
+            return t;
+        }
+
+        void begin_drain() { draining_ = true; }
+
+        // the barrier has completed. returns the idle clocks.
+        tsc_t end_drain(uth_comm& c)
+        {
+            if (parked_) {
+                c.fetch_and_add(&counters_[0][phase_], -1, 0);
+                parked_ = false;
+            }
+
+            terminated_ = false;
+            draining_ = false;
+            phase_ ^= 1;
+
+            return notify_work(c);
+        }
+    };
+
+}
+
+#endif
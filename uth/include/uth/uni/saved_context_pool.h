@@ -0,0 +1,115 @@
+#ifndef MADI_UNI_SAVED_CONTEXT_POOL_H
+#define MADI_UNI_SAVED_CONTEXT_POOL_H
+
+#include "../madi.h"
+#include "../debug.h"
+#include <cstddef>
+#include <cstdlib>
+
+namespace madi {
+
+    // per-worker freelists of saved_context blocks.
+    //
+    // a thread is packed into a saved_context every time it is suspended,
+    // and the block is freed as soon as the thread resumes, so the sizes
+    // of live blocks repeat closely. blocks are rounded up to a power of
+    // two and kept in one freelist per size class, linked through their
+    // first word. the total size of cached blocks is bounded by
+    // max_cached_bytes (MADM_SCTX_POOL_SIZE); 0 disables the pool.
+    class saved_context_pool {
+        MADI_NONCOPYABLE(saved_context_pool);
+
+        enum constants {
+            MAX_BLOCK_BITS = 24,
+        };
+
+        void *freelist_[MAX_BLOCK_BITS + 1];
+
+        size_t cached_bytes_;
+        size_t max_cached_bytes_;
+
+        static size_t index_of_size(size_t size)
+        {
+            return 64UL - static_cast<size_t>(__builtin_clzl(size - 1));
+        }
+
+    public:
+        saved_context_pool() : cached_bytes_(0), max_cached_bytes_(0)
+        {
+            for (size_t i = 0; i <= MAX_BLOCK_BITS; i++)
+                freelist_[i] = NULL;
+        }
+
+        ~saved_context_pool()
+        {
+            finalize();
+        }
+
+        void initialize(size_t max_cached_bytes)
+        {
+            finalize();
+            max_cached_bytes_ = max_cached_bytes;
+        }
+
+        void finalize()
+        {
+            for (size_t i = 0; i <= MAX_BLOCK_BITS; i++) {
+                void *p = freelist_[i];
+                while (p != NULL) {
+                    void *next = *reinterpret_cast<void **>(p);
+                    free(p);
+                    p = next;
+                }
+                freelist_[i] = NULL;
+            }
+
+            cached_bytes_ = 0;
+        }
+
+        size_t cached_bytes() const { return cached_bytes_; }
+
+        void * allocate(size_t size)
+        {
+            size_t idx = index_of_size(size);
+
+            if (idx > MAX_BLOCK_BITS)
+                return malloc(size);
+
+            void *p = freelist_[idx];
+
+            if (p != NULL) {
+                freelist_[idx] = *reinterpret_cast<void **>(p);
+                cached_bytes_ -= 1UL << idx;
+                return p;
+            }
+
+            // allocate the whole class so that the block can be reused
+            // for any size in the class.
+            p = malloc(1UL << idx);
+
+            if (p == NULL)
+                MADI_DIE("saved context allocation failed (size = %zu)",
+                         size);
+
+            return p;
+        }
+
+        void deallocate(void *p, size_t size)
+        {
+            size_t idx = index_of_size(size);
+
+            if (idx > MAX_BLOCK_BITS ||
+                cached_bytes_ + (1UL << idx) > max_cached_bytes_) {
+                free(p);
+                return;
+            }
+
+            *reinterpret_cast<void **>(p) = freelist_[idx];
+            freelist_[idx] = p;
+            cached_bytes_ += 1UL << idx;
+        }
+    };
+
+}
+
+#endif
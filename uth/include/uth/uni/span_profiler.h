@@ -0,0 +1,172 @@
+#ifndef MADI_UNI_SPAN_PROFILER_H
+#define MADI_UNI_SPAN_PROFILER_H
+
+#include "../madi.h"
+#include "../uth_options.h"
+#include "../uth_comm.h"
+#include "../misc.h"
+#include <madm_comm.h>
+#include <algorithm>
+#include <cstdio>
+
+namespace madi {
+
+    // the critical path length of a strand, without and with the cost
+    // of steals (burden) on the continuations of forks
+    struct span_state {
+        long span;
+        long bspan;
+    };
+
+    // a value of a future together with the span of the thread filling it
+    template <class T>
+    struct spanned {
+        T value;
+        span_state state;
+    };
+
+    // work/span profiler in the manner of Cilkview (MADM_SPAN_PROFILE=1).
+    //
+    // the worker measures the clocks the running thread spends between
+    // the points where its strand forks, joins or blocks, and adds them
+    // to the work of the process and to the span of the strand. a child
+    // thread starts from the span at the fork, and so does the
+    // continuation, with one steal added to its burdened span; a future
+    // carries the span of its thread to the thread touching it, which
+    // continues from the larger of the two. the burden of a steal is
+    // the mean clocks of the steals completed on the process so far
+    // (uth_options.span_burden before the first one).
+    class span_profiler {
+        bool enabled_;
+        tsc_t seg_start_;
+        span_state cur_;
+        long work_;
+
+        long n_steals_;
+        long steal_clocks_;
+
+        span_state final_;      // the strand of the main thread at its end
+
+    public:
+        span_profiler() :
+            enabled_(false), seg_start_(0), work_(0),
+            n_steals_(0), steal_clocks_(0)
+        {
+            cur_.span = cur_.bspan = 0;
+            final_.span = final_.bspan = 0;
+        }
+
+        void initialize()
+        {
+            enabled_ = uth_options.span_profile != 0;
+        }
+
+        bool enabled() const { return enabled_; }
+
+        void begin_main()
+        {
+            cur_.span = cur_.bspan = 0;
+            seg_start_ = rdtsc();
+        }
+
+        void end_main()
+        {
+            final_ = fold();
+        }
+
+        // ends the running segment. returns the state of the strand.
+        span_state fold()
+        {
+            tsc_t t = rdtsc();
+            long d = (long)(t - seg_start_);
+
+            work_ += d;
+            cur_.span += d;
+            cur_.bspan += d;
+            seg_start_ = t;
+
+            return cur_;
+        }
+
+        // the running thread continues the strand in state s
+        void restore(const span_state& s)
+        {
+            cur_ = s;
+            seg_start_ = rdtsc();
+        }
+
+        // the continuation of a fork at state s
+        span_state continuation(span_state s) const
+        {
+            s.bspan += burden();
+            return s;
+        }
+
+        // the running strand joins the strand which ended in state s
+        void join(const span_state& s)
+        {
+            fold();
+            cur_.span = std::max(cur_.span, s.span);
+            cur_.bspan = std::max(cur_.bspan, s.bspan);
+        }
+
+        void notify_steal(long clocks)
+        {
+            n_steals_ += 1;
+            steal_clocks_ += clocks;
+        }
+
+        long burden() const
+        {
+            return (n_steals_ > 0) ? steal_clocks_ / n_steals_
+                                   : (long)uth_options.span_burden;
+        }
+
+        // collective
+        void report(uth_comm& c)
+        {
+            if (!enabled_)
+                return;
+
+            long work = 0, span = 0, bspan = 0;
+            long n_steals = 0, steal_clocks = 0;
+            comm::reduce(&work, &work_, 1, 0, comm::reduce_op_sum);
+            comm::reduce(&span, &final_.span, 1, 0, comm::reduce_op_max);
+            comm::reduce(&bspan, &final_.bspan, 1, 0, comm::reduce_op_max);
+            comm::reduce(&n_steals, &n_steals_, 1, 0, comm::reduce_op_sum);
+            comm::reduce(&steal_clocks, &steal_clocks_, 1, 0,
+                         comm::reduce_op_sum);
+
+            if (c.get_pid() != 0)
+                return;
+
+            double parallelism = (span > 0) ? (double)work / span : 0.0;
+            double bparallelism = (bspan > 0) ? (double)work / bspan : 0.0;
+            long burden = (n_steals > 0) ? steal_clocks / n_steals
+                                         : (long)uth_options.span_burden;
+
+            printf("work = %ld, span = %ld, parallelism = %.2f\n"
+                   "burdened_span = %ld, burdened_parallelism = %.2f "
+                   "(steal burden = %ld clocks from %ld steals)\n",
+                   work, span, parallelism,
+                   bspan, bparallelism, burden, n_steals);
+
+            // speedup on P processes is at most min(P, parallelism), and
+            // about work / (work / P + (1 - 1 / P) burdened span) with the
+            // costs of steals, which do not happen on one process
+            size_t max_p = std::max((size_t)64, 4 * c.get_n_procs());
+
+            printf("predicted speedup (P: upper bound, burdened):\n");
+            for (size_t p = 1; p <= max_p; p *= 2) {
+                double upper = std::min((double)p, parallelism);
+                double t_p = (double)work / p
+                           + (double)bspan * (1.0 - 1.0 / p);
+                double burdened = (t_p > 0) ? (double)work / t_p : 0.0;
+                printf("  %4zu: %8.2f %8.2f\n", p, upper, burdened);
+            }
+        }
+    };
+
+}
+
+#endif
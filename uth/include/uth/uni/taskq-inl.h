@@ -4,6 +4,7 @@
 #include "taskq.h"
 #include "../uth_comm.h"
 #include <madm/threadsafe.h>
+#include <algorithm>
 
 namespace madi {
 
@@ -65,34 +66,11 @@ namespace madi {
 
         comm::threadsafe::rbarrier();
 
-        if (t == n_entries_) {
-            local_lock();
+        // a stale base_ only makes this check conservative
+        while (t - base_ >= n_entries_ - n_reserved_)
+            grow(t);
 
-            if (base_ == 0)
-                madi::die("task queue overflow");
-
-            int offset_x2 = n_entries_ - (base_ + top_);
-            int offset = offset_x2 / 2;
-
-            if (offset_x2 % 2)
-                offset -= 1;
-
-            if (top_ - base_) {
-                int dst = base_ + offset;
-                int src = base_;
-                size_t size = sizeof(taskq_entry) * (top_ - base_);
-                memmove(&entries_[dst], &entries_[src], size);
-            }
-
-            top_ += offset;
-            base_ += offset;
-
-            t = top_;
-
-            local_unlock();
-        }
-
-        entries_[t] = entry;
+        entries_[t & (n_entries_ - 1)] = entry;
 
         comm::threadsafe::wbarrier();
 
@@ -115,8 +93,15 @@ namespace madi {
 
         int b = base_;
 
+        if (lockfree_) {
+            if (b < t)
+                return &entries_[t & (n_entries_ - 1)];
+            else
+                return pop_lockfree(t);
+        }
+
         if (b + 1 < t) {
-            return &entries_[t];
+            return &entries_[t & (n_entries_ - 1)];
         }
 
         local_lock();
@@ -125,10 +110,16 @@ namespace madi {
 
         taskq_entry *result;
         if (b <= t) {
-            result = &entries_[t];
+            result = &entries_[t & (n_entries_ - 1)];
         } else {
-            top_ = n_entries_ / 2;
-            base_ = top_;
+            // a pipelined thief may still be transferring the frame of
+            // the parent after steal_unlock
+            while (word_thieves(steal_word_) != 0)
+                MADI_UTH_COMM_POLL();
+
+            // restart the empty queue from index 0
+            top_ = 0;
+            base_ = 0;
 
             result = NULL;
         }
@@ -137,6 +128,79 @@ namespace madi {
 
         return result;
     }
+
+    inline taskq_entry * global_taskque::segment_of(long w,
+                                                    int *n_entries) const
+    {
+        // NULL if this is a snapshot taken while the queue was growing
+        int seg = word_segment(w);
+
+        *n_entries = initial_n_entries_ << seg;
+        return segments_[seg];
+    }
+
+    inline long global_taskque::wait_thieves_lockfree()
+    {
+        for (;;) {
+            long w = steal_word_;
+
+            if (word_thieves(w) == 0)
+                return w;
+
+            MADI_UTH_COMM_POLL();
+        }
+    }
+
+    inline long global_taskque::rebased_word(long w, int base)
+    {
+        long epoch = (word_epoch(w) + 1) & 0x7FFF;
+        long seg = word_segment(w);
+        return epoch * epoch_unit + seg * segment_unit + base;
+    }
+
+    inline taskq_entry * global_taskque::pop_lockfree(int t)
+    {
+        // entries_[t] is the last entry, or it has been claimed by a thief
+        // (THE-style conflict resolution).
+        for (;;) {
+            long w = steal_word_;
+            int b = word_base(w);
+
+            if (b == t) {
+                // race with thieves for the last entry
+                if (comm::threadsafe::compare_and_swap(&steal_word_,
+                                                       w, w + 1)) {
+                    top_ = t + 1;
+                    return &entries_[t & (n_entries_ - 1)];
+                }
+            } else if (b > t) {
+                // stolen. the thief may still be transferring the frame
+                // of the parent, so wait for it before the frame is
+                // overwritten.
+                if (word_thieves(w) == 0)
+                    break;
+            } else {
+                return &entries_[t & (n_entries_ - 1)];
+            }
+
+            MADI_UTH_COMM_POLL();
+        }
+
+        // restart the empty queue from index 0
+        top_ = 0;
+
+        comm::threadsafe::rwbarrier();
+
+        for (;;) {
+            long w = wait_thieves_lockfree();
+            long new_w = rebased_word(w, 0);
+
+            if (comm::threadsafe::compare_and_swap(&steal_word_, w, new_w))
+                break;
+        }
+
+        return NULL;
+    }
 #if 0
     inline bool global_taskque::steal(taskq_entry *entry)
     {
@@ -188,15 +252,70 @@ namespace madi {
         return remote_unlock(c, target);
     }
 
+    inline bool global_taskque::steal_lockfree(uth_comm& c,
+                                               madi::pid_t target,
+                                               taskq_entry *entry,
+                                               global_taskque *taskq_buf,
+                                               bool *contended)
+    {
+        // assume that `this' pointer is remote, and that taskq_buf holds
+        // a snapshot of it fetched by empty().
+        //
+        // claim entries[b] by compare-and-swap on steal_word_ (Chase-Lev).
+        // top_ must be read after base_ of the snapshot, and the epoch
+        // in steal_word_ makes the claim fail if the owner has moved base_
+        // backward in the meantime.
+        long w = taskq_buf->steal_word_;
+        int b = word_base(w);
+
+        *contended = false;
+
+        int t = c.get_value((int *)&top_, target);
+
+        if (b >= t)
+            return false;
+
+        int n_entries;
+        taskq_entry *entries = taskq_buf->segment_of(w, &n_entries);
+
+        if (entries == NULL) {
+            *contended = true;
+            return false;
+        }
+
+        // read the entry before the claim: the owner overwrites the slot
+        // only after base_ has passed b, and a claim on a snapshot of an
+        // old segment fails because growing the queue changes steal_word_.
+        c.get(entry, &entries[b & (n_entries - 1)], sizeof(*entry), target);
+
+        long new_w = w + thief_unit + 1;
+        if (!c.compare_and_swap((long *)&steal_word_, w, new_w, target)) {
+            *contended = true;
+            return false;
+        }
+
+        return true;
+    }
+
+    inline void global_taskque::steal_release(uth_comm& c,
+                                              madi::pid_t target)
+    {
+        // the owner can reuse the frame of the stolen entry after this
+        c.fetch_and_add((long *)&steal_word_, -thief_unit, target);
+    }
+
     inline bool global_taskque::steal(uth_comm& c,
                                       madi::pid_t target,
-                                      taskq_entry *entries,
                                       taskq_entry *entry,
-                                      global_taskque *taskq_buf)
+                                      global_taskque *taskq_buf,
+                                      bool pipelined)
     {
         // assume that `this' pointer is remote.
         // assume that this function is protected by
         // steal_trylock and steal_unlock.
+        //
+        // if pipelined, the thief is also counted in steal_word_, and
+        // it must call steal_release after the stack transfer.
 #define ELIMINATE_PUT 1
 #define USE_FAD 0
 
@@ -230,15 +349,22 @@ namespace madi {
         bool result;
         if (b < t) {
 #if ELIMINATE_PUT
-            c.put_value((int *)&base_, self.base_ + 1, target);
+            if (pipelined)
+                c.fetch_and_add((long *)&steal_word_, thief_unit + 1, target);
+            else
+                c.put_value((int *)&base_, self.base_ + 1, target);
 #endif
+            int n_entries;
+            taskq_entry *entries = self.segment_of(self.steal_word_,
+                                                   &n_entries);
+            taskq_entry *src = &entries[b & (n_entries - 1)];
+
             MADI_DPUTS3("RDMA_GET(%p, %p, %zu) rma_entries[%d] = %p",
-                        entry, &entries[b], sizeof(*entry), 
-                        target, entries);
+                        entry, src, sizeof(*entry), target, entries);
 
             MADI_CHECK(entries != NULL);
 
-            c.get(entry, &entries[b], sizeof(*entry), target);
+            c.get(entry, src, sizeof(*entry), target);
 
             MADI_DPUTS3("RDMA_GET done");
 
@@ -252,6 +378,77 @@ namespace madi {
 
         return result;
     }
+
+    inline size_t global_taskque::steal_batch(uth_comm& c,
+                                              madi::pid_t target,
+                                              taskq_entry *entry_buf,
+                                              size_t max_entries,
+                                              global_taskque *taskq_buf,
+                                              bool pipelined)
+    {
+        // assume that `this' pointer is remote.
+        // assume that this function is protected by
+        // steal_trylock and steal_unlock.
+        global_taskque& self = *taskq_buf; // RMA buffer
+        c.get(&self, this, sizeof(self), target);
+        int b = self.base_;
+        int t = self.top_;
+
+        if (b >= t)
+            return 0;
+
+        // steal the older half of [b, t) at most
+        int n = std::min((t - b + 1) / 2, (int)max_entries);
+
+        if (pipelined)
+            c.fetch_and_add((long *)&steal_word_, thief_unit + n, target);
+        else
+            c.put_value((int *)&base_, b + n, target);
+
+        if (n > 2) {
+            // the owner pops entries without the lock while
+            // base_ + 1 < top_, so entries at b + 2 or above may have been
+            // popped before the owner observes the new base_.
+            // re-read top_, and give back the entries above it.
+            int t2 = c.get_value((int *)&top_, target);
+            int end = std::max(b, std::min(b + n, t2));
+
+            if (end < b + n) {
+                if (pipelined)
+                    c.fetch_and_add((long *)&steal_word_,
+                                    (long)(end - (b + n)), target);
+                else
+                    c.put_value((int *)&base_, end, target);
+
+                n = end - b;
+            }
+
+            if (n == 0) {
+                if (pipelined)
+                    steal_release(c, target);
+
+                return 0;
+            }
+        }
+
+        int n_entries;
+        taskq_entry *entries = self.segment_of(self.steal_word_, &n_entries);
+
+        MADI_CHECK(entries != NULL);
+
+        // [b, b + n) may wrap around the end of the ring buffer
+        int first = b & (n_entries - 1);
+        int n_first = std::min(n, n_entries - first);
+
+        c.get(entry_buf, &entries[first], sizeof(*entry_buf) * n_first,
+              target);
+
+        if (n_first < n)
+            c.get(entry_buf + n_first, &entries[0],
+                  sizeof(*entry_buf) * (n - n_first), target);
+
+        return (size_t)n;
+    }
 #else
     inline void global_taskque::push(const taskq_entry& entry)
     {
@@ -17,6 +17,7 @@ namespace madi {
         uint8_t *frame_base;
         size_t frame_size;
         context *ctx;
+        long future;    // the future the thread fills, or -1
     };
 
 #define MADI_TENTRY_PRINT(level, entry_ptr) \
@@ -58,19 +59,71 @@ namespace madi {
     class global_taskque {
         MADI_NONCOPYABLE(global_taskque);
 
+        enum constants {
+            MAX_SEGMENTS = 16,
+        };
+
+        // the queue is a ring buffer: top_ and base_ are logical indices
+        // which only grow while the queue is not empty, and the entry of
+        // index i is stored at entries_[i & (n_entries_ - 1)].
         volatile int top_;
-        volatile int base_;
 
+        // for the lock-free and pipelined steal protocols, base_ shares
+        // a 64-bit word with the number of thieves which claimed an entry
+        // but have not finished the stack transfer yet, and with an epoch
+        // which is incremented whenever the owner moves base_ backward
+        // (lock-free protocol only). the segment field is the index of
+        // the current ring buffer in segments_.
+        // layout: [63:48] epoch, [47:44] segment, [43:32] # of thieves,
+        //         [31:0] base_
+        union {
+            volatile long steal_word_;
+            struct {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+                volatile int steal_tag_;
+                volatile int base_;
+#else
+                volatile int base_;
+                volatile int steal_tag_;
+#endif
+            };
+        };
+
+        // the current ring buffer, owned by the owner
         int n_entries_;
         taskq_entry *entries_;
 
+        // when the ring buffer becomes full, the queue grows into a new
+        // segment twice as large, and publishes it in segments_ so that
+        // thieves can find it with the segment field of steal_word_.
+        // the size of segments_[i] is initial_n_entries_ << i.
+        // segments are carved from growth_entries_, which is registered
+        // for RDMA at initialization because memory registration is a
+        // collective operation. old segments are never reused because
+        // thieves may still read entries from them.
+        int initial_n_entries_;
+        int max_n_entries_;
+        taskq_entry *growth_entries_;
+        taskq_entry *segments_[MAX_SEGMENTS];
+
+        // # of entries below base_ which thieves may still be reading
+        // after moving base_ (up to a batch of a steal-half)
+        int n_reserved_;
+
         volatile int lock_;
+
+        bool lockfree_;
+
+        static const long thief_unit = 1L << 32;
+        static const long segment_unit = 1L << 44;
+        static const long epoch_unit = 1L << 48;
         
     public:
         global_taskque();
         ~global_taskque();
 
-        void initialize(uth_comm& c, taskq_entry *entries, size_t n_entries);
+        void initialize(uth_comm& c, taskq_entry *entries, size_t n_entries,
+                        taskq_entry *growth_entries, size_t max_n_entries);
         void finalize(uth_comm& c);
 
         void push(const taskq_entry& entry);
@@ -78,11 +131,21 @@ namespace madi {
 
         bool empty(uth_comm& c, madi::pid_t target, global_taskque *taskq_buf);
         bool steal(taskq_entry *entry);
-        bool steal(uth_comm& c, madi::pid_t target, taskq_entry *entries,
-                   taskq_entry *entry, global_taskque *taskq_buf);
+        bool steal(uth_comm& c, madi::pid_t target,
+                   taskq_entry *entry, global_taskque *taskq_buf,
+                   bool pipelined = false);
+        size_t steal_batch(uth_comm& c, madi::pid_t target,
+                           taskq_entry *entry_buf,
+                           size_t max_entries, global_taskque *taskq_buf,
+                           bool pipelined = false);
         bool steal_trylock(uth_comm& c, madi::pid_t target);
         void steal_unlock(uth_comm& c, madi::pid_t target);
 
+        bool steal_lockfree(uth_comm& c, madi::pid_t target,
+                            taskq_entry *entry,
+                            global_taskque *taskq_buf, bool *contended);
+        void steal_release(uth_comm& c, madi::pid_t target);
+
     private:
         bool local_trylock();
         void local_lock();
@@ -90,6 +153,18 @@ namespace madi {
 
         bool remote_trylock(uth_comm& c, madi::pid_t target);
         void remote_unlock(uth_comm& c, madi::pid_t target);
+
+        void grow(int t);
+        taskq_entry * segment_of(long w, int *n_entries) const;
+
+        taskq_entry * pop_lockfree(int t);
+        long wait_thieves_lockfree();
+        static long rebased_word(long w, int base);
+
+        static int word_base(long w) { return (int)(w & 0xFFFFFFFFL); }
+        static int word_thieves(long w) { return (int)((w >> 32) & 0xFFF); }
+        static int word_segment(long w) { return (int)((w >> 44) & 0xF); }
+        static int word_epoch(long w) { return (int)((w >> 48) & 0x7FFF); }
     };
 
     typedef global_taskque taskque;
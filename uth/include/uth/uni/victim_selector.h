@@ -0,0 +1,160 @@
+#ifndef MADI_UNI_VICTIM_SELECTOR_H
+#define MADI_UNI_VICTIM_SELECTOR_H
+
+#include "../madi.h"
+#include "../uth_options.h"
+#include "../debug.h"
+#include "../misc.h"
+#include <madm_comm.h>
+#include <algorithm>
+
+namespace madi {
+
+    // victim selection for work stealing.
+    //
+    // processes are grouped into nodes of comm::options.n_procs_per_node
+    // consecutive pids. the hierarchical policy prefers victims within the
+    // same node because a remote steal costs several inter-node RDMA round
+    // trips, and escalates to remote nodes with probability
+    // uth_options.victim_remote_prob (%) or when every intra-node peer has
+    // failed in a row. the affinity policy retries the last victim a steal
+    // succeeded on, and falls back to the hierarchical policy otherwise.
+    class victim_selector {
+        int policy_;
+        madi::pid_t me_;
+        size_t n_procs_;
+
+        // [node_begin_, node_end_) is the pid range of my node
+        size_t node_begin_;
+        size_t node_end_;
+
+        size_t remote_prob_;
+        size_t n_local_failures_;
+
+        bool has_last_victim_;
+        madi::pid_t last_victim_;
+
+    public:
+        victim_selector() :
+            policy_(victim_policy_random), me_(0), n_procs_(0),
+            node_begin_(0), node_end_(0),
+            remote_prob_(0), n_local_failures_(0),
+            has_last_victim_(false), last_victim_(0)
+        {
+        }
+
+        void initialize(madi::pid_t me, size_t n_procs)
+        {
+            size_t n_procs_per_node = comm::options.n_procs_per_node;
+            if (n_procs_per_node == 0)
+                n_procs_per_node = 1;
+
+            policy_ = uth_options.victim_policy;
+            me_ = me;
+            n_procs_ = n_procs;
+            node_begin_ = me / n_procs_per_node * n_procs_per_node;
+            node_end_ = std::min(node_begin_ + n_procs_per_node, n_procs);
+            remote_prob_ = uth_options.victim_remote_prob;
+            n_local_failures_ = 0;
+            has_last_victim_ = false;
+            last_victim_ = 0;
+        }
+
+        madi::pid_t select()
+        {
+            switch (policy_) {
+            case victim_policy_random:
+                return select_randomly();
+            case victim_policy_hierarchical:
+                return select_hierarchically();
+            case victim_policy_affinity:
+                if (has_last_victim_)
+                    return last_victim_;
+                else
+                    return select_hierarchically();
+            default:
+                MADI_NOT_REACHED;
+            }
+        }
+
+        void notify_success(madi::pid_t victim)
+        {
+            if (is_local(victim))
+                n_local_failures_ = 0;
+
+            has_last_victim_ = true;
+            last_victim_ = victim;
+        }
+
+        void notify_failure(madi::pid_t victim)
+        {
+            if (is_local(victim))
+                n_local_failures_ += 1;
+
+            if (has_last_victim_ && last_victim_ == victim)
+                has_last_victim_ = false;
+        }
+
+        bool is_local(madi::pid_t pid) const
+        {
+            return node_begin_ <= pid && pid < node_end_;
+        }
+
+    private:
+        size_t n_local_peers() const { return node_end_ - node_begin_ - 1; }
+        size_t n_remote_procs() const
+        {
+            return n_procs_ - (node_end_ - node_begin_);
+        }
+
+        madi::pid_t select_randomly()
+        {
+            madi::pid_t pid;
+            do {
+                pid = (madi::pid_t)random_int((int)n_procs_);
+                MADI_CHECK((size_t)pid != n_procs_);
+            } while (pid == me_);
+
+            return pid;
+        }
+
+        madi::pid_t select_locally()
+        {
+            // pick one of the other processes in [node_begin_, node_end_)
+            size_t idx = (size_t)random_int((int)n_local_peers());
+            madi::pid_t pid = node_begin_ + idx;
+
+            return (pid >= me_) ? pid + 1 : pid;
+        }
+
+        madi::pid_t select_remotely()
+        {
+            // pick a process outside [node_begin_, node_end_)
+            size_t idx = (size_t)random_int((int)n_remote_procs());
+
+            return (idx < node_begin_) ? idx : idx + (node_end_ - node_begin_);
+        }
+
+        madi::pid_t select_hierarchically()
+        {
+            if (n_remote_procs() == 0)
+                return select_locally();
+
+            if (n_local_peers() == 0)
+                return select_remotely();
+
+            bool escalate = n_local_failures_ >= n_local_peers()
+                || (size_t)random_int(100) < remote_prob_;
+
+            if (escalate) {
+                n_local_failures_ = 0;
+                return select_remotely();
+            } else {
+                return select_locally();
+            }
+        }
+    };
+
+}
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef MADI_WAITQ_INL_H
+#define MADI_WAITQ_INL_H
+
+#include "waitq.h"
+#include "saved_context_pool.h"
+#include "../uth_comm.h"
+#include <madm/threadsafe.h>
+#include <cstddef>
+
+namespace madi {
+
+    inline global_waitq::global_waitq() :
+        lock_(0), top_(0), base_(0), wanted_(0),
+        n_entries_(0), entries_(NULL),
+        buf_top_(0), buf_size_(0), buf_(NULL)
+    {
+    }
+
+    inline global_waitq::~global_waitq()
+    {
+    }
+
+    inline void global_waitq::initialize(uth_comm&, waitq_entry *entries,
+                                         size_t n_entries, uint8_t *buf,
+                                         size_t buf_size)
+    {
+        MADI_CHECK((n_entries & (n_entries - 1)) == 0);
+        MADI_CHECK(n_entries == 0 || (entries != NULL && buf != NULL));
+
+        lock_ = 0;
+        top_ = 0;
+        base_ = 0;
+        wanted_ = 0;
+        n_entries_ = (int)n_entries;
+        entries_ = entries;
+        buf_top_ = 0;
+        buf_size_ = buf_size;
+        buf_ = buf;
+    }
+
+    inline void global_waitq::finalize(uth_comm&)
+    {
+        MADI_ASSERT(base_ >= top_);
+
+        top_ = 0;
+        base_ = 0;
+        wanted_ = 0;
+        n_entries_ = 0;
+        entries_ = NULL;
+        buf_top_ = 0;
+        buf_size_ = 0;
+        buf_ = NULL;
+    }
+
+    inline bool global_waitq::local_trylock()
+    {
+        return comm::threadsafe::fetch_and_add(&lock_, 1) == 0;
+    }
+
+    inline void global_waitq::local_lock()
+    {
+        while (!local_trylock())
+            MADI_UTH_COMM_POLL();
+    }
+
+    inline void global_waitq::local_unlock()
+    {
+        comm::threadsafe::wbarrier();
+        lock_ = 0;
+    }
+
+    inline void global_waitq::rewind()
+    {
+        top_ = 0;
+        base_ = 0;
+        buf_top_ = 0;
+    }
+
+    inline bool global_waitq::push(saved_context *sctx)
+    {
+        MADI_ASSERT(!sctx->is_main_task);
+
+        size_t size = (sctx->stack_size + 7) & ~(size_t)7;
+
+        local_lock();
+
+        if (base_ >= top_)
+            rewind();
+
+        int t = top_;
+
+        if (t - base_ >= n_entries_ || buf_top_ + size > buf_size_) {
+            local_unlock();
+            return false;
+        }
+
+        waitq_entry& e = entries_[t & (n_entries_ - 1)];
+        e.offset = buf_top_;
+        e.ip = sctx->ip;
+        e.sp = sctx->sp;
+        e.ctx = sctx->ctx;
+        e.stack_top = sctx->stack_top;
+        e.stack_size = sctx->stack_size;
+        e.future = sctx->future;
+
+        memcpy(buf_ + buf_top_, sctx->partial_stack, sctx->stack_size);
+        buf_top_ += size;
+
+        top_ = t + 1;
+        wanted_ = 0;
+
+        local_unlock();
+        return true;
+    }
+
+    inline saved_context * global_waitq::pop(saved_context_pool& pool)
+    {
+        local_lock();
+
+        int t = top_ - 1;
+
+        if (t < base_) {
+            rewind();
+            local_unlock();
+            return NULL;
+        }
+
+        waitq_entry& e = entries_[t & (n_entries_ - 1)];
+
+        size_t size = offsetof(saved_context, partial_stack) + e.stack_size;
+        saved_context *sctx = (saved_context *)pool.allocate(size);
+
+        sctx->is_main_task = false;
+        sctx->ip = e.ip;
+        sctx->sp = e.sp;
+        sctx->ctx = e.ctx;
+        sctx->stack_top = e.stack_top;
+        sctx->stack_size = e.stack_size;
+        sctx->future = e.future;
+        memcpy(sctx->partial_stack, buf_ + e.offset, e.stack_size);
+
+        // the newest entry is at the end of buf_
+        top_ = t;
+        buf_top_ = e.offset;
+
+        local_unlock();
+        return sctx;
+    }
+
+    inline bool global_waitq::empty(uth_comm& c, madi::pid_t target,
+                                    global_waitq *waitq_buf)
+    {
+        global_waitq& self = *waitq_buf; // RMA buffer
+        c.get(&self, this, sizeof(self), target);
+
+        return self.n_entries_ == 0 || self.base_ >= self.top_;
+    }
+
+    inline void global_waitq::want(uth_comm& c, madi::pid_t target)
+    {
+        c.put_value((int *)&wanted_, 1, target);
+    }
+
+    inline bool global_waitq::steal_trylock(uth_comm& c, madi::pid_t target)
+    {
+        return c.fetch_and_add((int *)&lock_, 1, target) == 0;
+    }
+
+    inline void global_waitq::steal_unlock(uth_comm& c, madi::pid_t target)
+    {
+        c.put_value((int *)&lock_, 0, target);
+    }
+
+    inline bool global_waitq::steal(uth_comm& c, madi::pid_t target,
+                                    waitq_entry *entry,
+                                    global_waitq *waitq_buf)
+    {
+        // called under the lock of the target. the partial stack of the
+        // entry stays in the buffer of the target until steal_unlock.
+        global_waitq& self = *waitq_buf; // RMA buffer
+        c.get(&self, this, sizeof(self), target);
+
+        int b = self.base_;
+        int t = self.top_;
+
+        if (b >= t)
+            return false;
+
+        c.get(entry, self.entries_ + (b & (self.n_entries_ - 1)),
+              sizeof(waitq_entry), target);
+        c.put_value((int *)&base_, b + 1, target);
+
+        return true;
+    }
+
+}
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef MADI_WAITQ_H
+#define MADI_WAITQ_H
+
+#include "../madi.h"
+#include "context.h"
+#include "../misc.h"
+#include "../debug.h"
+#include <cstring>
+
+namespace madi {
+
+    class uth_comm;
+    class saved_context_pool;
+
+    // a suspended thread in global_waitq. the fields are those of
+    // saved_context, and the partial stack is at offset in the buffer.
+    struct waitq_entry {
+        size_t offset;
+        void *ip;
+        void *sp;
+        context *ctx;
+        uint8_t *stack_top;
+        size_t stack_size;
+        long future;
+    };
+
+    // ready threads which other processes can steal.
+    //
+    // a worker keeps ready threads in its local waitq. a thief which finds
+    // this queue empty sets wanted_, and then the owner moves one of the
+    // ready threads it cannot run right away to this queue in RDMA memory,
+    // so that no thread is copied out while nobody steals. a thief takes
+    // the oldest entry under lock_ and copies its partial stack directly
+    // to the same (iso-)address of its own call stack, as it does for a
+    // stolen taskq_entry frame, and releases lock_ after the copy. the
+    // owner takes back the newest entry when it runs out of threads.
+    //
+    // partial stacks are appended to buf_, which is rewound whenever the
+    // queue becomes empty.
+    class global_waitq {
+        MADI_NONCOPYABLE(global_waitq);
+
+        volatile int lock_;
+        volatile int top_;
+        volatile int base_;
+        volatile int wanted_;
+
+        int n_entries_;
+        waitq_entry *entries_;
+
+        size_t buf_top_;
+        size_t buf_size_;
+        uint8_t *buf_;
+
+    public:
+        global_waitq();
+        ~global_waitq();
+
+        void initialize(uth_comm& c, waitq_entry *entries, size_t n_entries,
+                        uint8_t *buf, size_t buf_size);
+        void finalize(uth_comm& c);
+
+        bool enabled() const { return n_entries_ > 0; }
+        bool local_empty() const { return base_ >= top_; }
+        bool wanted() const { return wanted_ != 0; }
+
+        bool push(saved_context *sctx);
+        saved_context * pop(saved_context_pool& pool);
+
+        bool empty(uth_comm& c, madi::pid_t target, global_waitq *waitq_buf);
+        void want(uth_comm& c, madi::pid_t target);
+        bool steal_trylock(uth_comm& c, madi::pid_t target);
+        void steal_unlock(uth_comm& c, madi::pid_t target);
+        bool steal(uth_comm& c, madi::pid_t target, waitq_entry *entry,
+                   global_waitq *waitq_buf);
+
+        // the address of the partial stack of a stolen entry on target
+        static uint8_t * stack_of(const waitq_entry& entry,
+                                  global_waitq *waitq_buf)
+        {
+            return waitq_buf->buf_ + entry.offset;
+        }
+
+    private:
+        bool local_trylock();
+        void local_lock();
+        void local_unlock();
+        void rewind();
+    };
+
+}
+
+#endif
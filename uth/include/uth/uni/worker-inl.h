@@ -108,6 +108,7 @@ namespace madi {
             entry.frame_base = ctx.top_ptr();
             entry.frame_size = ctx.stack_size();
             entry.ctx = &ctx;
+            entry.future = w0.current_future_;
 
             MADI_TENTRY_ASSERT(&entry);
 
@@ -159,6 +160,8 @@ namespace madi {
 
             MADI_CONTEXT_ASSERT_WITHOUT_PARENT(&ctx);
 
+            w1.trace_.record(MADI_TRACE_DIE);
+
             w1.go();
 
             MADI_NOT_REACHED;
@@ -183,6 +186,8 @@ namespace madi {
 
         std::tuple<Args...> arg(args...);
 
+        w0.trace_.record(MADI_TRACE_FORK);
+
 #if MADI_ARCH_TYPE == MADI_ARCH_SPARC64
         uint8_t *sp0, *fp0, *i70;
         MADI_GET_CURRENT_SP(&sp0);
@@ -221,7 +226,13 @@ namespace madi {
         long t0 = g_prof->current_steal().tmp;
         if (t0 != 0) {
             long t1 = rdtsc();
-            g_prof->current_steal().resume = t1 - t0;
+            prof_steal_entry& e = g_prof->current_steal();
+            e.resume = t1 - t0;
+            e.tmp = 0;
+
+            if (w1.span_.enabled())
+                w1.span_.notify_steal(e.total());
+
             g_prof->next_steal();
 
             MADI_DPUTSR1("resume done");
@@ -241,6 +252,10 @@ namespace madi {
 
             MADI_DPUTS1("a main task is resuming");
 
+            current_future_ = -1;
+
+            trace_.record(MADI_TRACE_RESUME);
+
             MADI_CONTEXT_PRINT(1, main_ctx_);
             MADI_RESUME_CONTEXT(main_ctx_);
         } else if (!waitq_.empty()) {
@@ -267,7 +282,7 @@ namespace madi {
 /*
  * this macro must be called in the same function the ctx saved.
  */
-#define MADI_THREAD_PACK(ctx_ptr, is_main, sctx_ptr)                    \
+#define MADI_THREAD_PACK(ctx_ptr, is_main, fut, sctx_ptr)               \
     do {                                                                \
         context& ctx__ = *(ctx_ptr);                                    \
         void *ip__ = ctx__.instr_ptr();                                 \
@@ -279,13 +294,15 @@ namespace madi {
         size_t size__ = offsetof(saved_context, partial_stack) + stack_size__;\
                                                                         \
         /* copy stack frames to heap */                                 \
-        saved_context *sctx__ = (saved_context *)malloc(size__);        \
+        saved_context *sctx__ = (saved_context *)                       \
+            madi::current_worker().sctx_pool().allocate(size__);        \
         sctx__->is_main_task = (is_main);                               \
         sctx__->ip = ip__;                                              \
         sctx__->sp = sp__;                                              \
         sctx__->ctx = &ctx__;                                           \
         sctx__->stack_top = top__;                                      \
         sctx__->stack_size = stack_size__;                              \
+        sctx__->future = (fut);                                         \
         memcpy(sctx__->partial_stack, top__, stack_size__);             \
                                                                         \
         MADI_DPUTSB2("suspended [%p, %p) (size = %zu)",                 \
@@ -306,7 +323,8 @@ namespace madi {
 
         // pack the current thread (stack)
         saved_context *sctx = NULL;
-        MADI_THREAD_PACK(ctx_ptr, w0.is_main_task_, &sctx);
+        MADI_THREAD_PACK(ctx_ptr, w0.is_main_task_, w0.current_future_,
+                         &sctx);
 
         if (!w0.is_main_task_) {
             MADI_CONTEXT_ASSERT(ctx_ptr);
@@ -341,6 +359,8 @@ namespace madi {
         saved_context *sctx = NULL;
         std::tuple<saved_context *, Args...> arg(sctx, args...);
 
+        w0.trace_.record(MADI_TRACE_SUSPEND);
+
         // save current state
         MADI_SAVE_CONTEXT_WITH_CALL(prev_ctx, fp, (void *)f, (void *)&arg);
 
@@ -3,7 +3,13 @@
 
 #include "../madi.h"
 #include "taskq.h"
+#include "waitq.h"
 #include "context.h"
+#include "victim_selector.h"
+#include "idle_controller.h"
+#include "span_profiler.h"
+#include "../trace.h"
+#include "saved_context_pool.h"
 #include "../future.h"
 #include "../debug.h"
 #include <deque>
@@ -28,11 +34,17 @@ namespace madi {
 
         friend void madi_worker_do_resume_remote(void *p0, void *p1, 
                                                  void *p2, void *p3);
+        friend void resume_context(saved_context *sctx, context *ctx,
+                                   long future);
         friend void resume_saved_context(saved_context *sctx, 
                                          saved_context *next_sctx);
         friend void resume_remote_context(saved_context *sctx, 
-                                          std::tuple<taskq_entry *,
+                                          std::tuple<taskq_entry *, size_t,
                                           madi::pid_t, taskque *, tsc_t> *arg);
+        friend void resume_waiting_context(saved_context *sctx,
+                                           std::tuple<waitq_entry *,
+                                           uint8_t *, madi::pid_t,
+                                           global_waitq *> *arg);
 
         context *parent_ctx_;
         bool is_main_task_;
@@ -42,13 +54,38 @@ namespace madi {
         taskque *taskq_;
         taskque **taskq_array_;
         taskq_entry **taskq_entries_array_;
+        taskq_entry **taskq_growth_array_;
         taskque *taskq_buf_;
         taskq_entry *taskq_entry_buf_;
 
+        // ready threads which other processes can steal
+        global_waitq *gwaitq_;
+        global_waitq **gwaitq_array_;
+        waitq_entry **gwaitq_entries_array_;
+        uint8_t **gwaitq_stacks_array_;
+        global_waitq *gwaitq_buf_;
+        waitq_entry *gwaitq_entry_buf_;
+
+        victim_selector victims_;
+        idle_controller idle_;
+        trace_recorder trace_;
+        span_profiler span_;
+
         future_pool fpool_;
+        saved_context_pool sctx_pool_;
 
         context *main_ctx_;
         std::deque<saved_context *> waitq_;
+        std::deque<saved_context *> stash_;
+
+        // the future the current thread waits for in do_scheduler_work
+        int wait_id_;
+        madi::pid_t wait_pid_;
+
+        // the future the running thread fills (see future_pool::
+        // future_word), and the victim for the next steal if it is valid
+        long current_future_;
+        long leap_target_;
         
         bool done_;
 
@@ -77,19 +114,42 @@ namespace madi {
         void suspend(F f, Args... args);
 
         void do_scheduler_work();
+        void do_scheduler_work(int wait_id, madi::pid_t wait_pid,
+                               madi::pid_t runner);
+
+        void put_suspended(saved_context *sctx);
 
         future_pool& fpool() { return fpool_; }
+        saved_context_pool& sctx_pool() { return sctx_pool_; }
         taskque& taskq() { return *taskq_; }
         std::deque<saved_context *>& waitq() { return waitq_; }
+        std::deque<saved_context *>& stash() { return stash_; }
+        idle_controller& idle() { return idle_; }
+        trace_recorder& trace() { return trace_; }
+        span_profiler& span() { return span_; }
 
         size_t max_stack_usage() const { return max_stack_usage_; }
 
+        long current_future() const { return current_future_; }
+        void set_current_future(long future) { current_future_ = future; }
+
     private:
         void go();
         static void do_resume(worker& w, const taskq_entry& entry,
                               madi::pid_t victim);
-        bool steal_with_lock(taskq_entry *entry, madi::pid_t *victim,
-                             taskque **taskq);
+        madi::pid_t select_victim(bool *leap);
+        bool steal(taskq_entry *entries, size_t *n_entries,
+                   madi::pid_t *victim, taskque **taskq);
+        bool steal_with_lock(taskq_entry *entries, size_t *n_entries,
+                             madi::pid_t *victim, taskque **taskq);
+        bool steal_without_lock(taskq_entry *entries, size_t *n_entries,
+                                madi::pid_t *victim, taskque **taskq);
+        bool steal_waiting(waitq_entry **entry, uint8_t **stack,
+                           madi::pid_t *victim, global_waitq **waitq);
+        void export_waiting();
+        bool import_waiting();
+        bool can_park();
+        void leave_idle();
         bool is_main_task();
     };
     
@@ -10,6 +10,7 @@
 #define MADI_USE_MCOMM 1
 
 #include <madm/madm_comm_config.h>
+#include <madm/rma_handle.h>
 
 #if !MADI_USE_MCOMM
 
@@ -85,18 +86,27 @@ namespace madi {
                           madi::pid_t target);
         void get_buffered(void *dst, void *src, size_t size,
                           madi::pid_t target);
+        uint8_t *buffer() { return buffer_; }
+        size_t buffer_size() const { return buffer_size_; }
         void put_value(int *dst, int value, madi::pid_t target);
         void put_value(long *dst, long value, madi::pid_t target);
         int  get_value(int *src, madi::pid_t target);
         long get_value(long *src, madi::pid_t target);
         void swap(int *dst, int *src, madi::pid_t target);
         int fetch_and_add(int *dst, int value, madi::pid_t target);
+        long fetch_and_add(long *dst, long value, madi::pid_t target);
+        bool compare_and_swap(long *dst, long old_v, long new_v,
+                              madi::pid_t target);
 
         void **reg_mmap_shared(void *addr, size_t size);
         void reg_munmap_shared(void **ptrs, void *addr, size_t size);
 
         void reg_put(void *dst, void *src, size_t size, madi::pid_t target);
         void reg_get(void *dst, void *src, size_t size, madi::pid_t target);
+        comm::rma_handle reg_get_nbi(void *dst, void *src, size_t size,
+                                     madi::pid_t target);
+        void wait(const comm::rma_handle& h);
+        void fence();
 
         void barrier();
         bool barrier_try();
@@ -113,24 +123,43 @@ namespace madi {
 #define MADI_UTH_COMM_POLL() ((void)0)
 #endif
 
+    // the bounce buffer is registered for RDMA. larger data is sent in
+    // pieces of buffer_size_ bytes.
+
     inline void uth_comm::put_buffered(void *dst, void *src, size_t size,
                                        madi::pid_t target)
     {
-        MADI_ASSERT(size <= buffer_size_);
+        uint8_t *d = (uint8_t *)dst;
+        uint8_t *s = (uint8_t *)src;
+
+        while (size > 0) {
+            size_t n = (size < buffer_size_) ? size : buffer_size_;
 
-        memcpy(buffer_, src, size);
+            memcpy(buffer_, s, n);
+            put(d, buffer_, n, target);
 
-        put(dst, buffer_, size, target);
+            d += n;
+            s += n;
+            size -= n;
+        }
     }
 
     inline void uth_comm::get_buffered(void *dst, void *src, size_t size,
                                        madi::pid_t target)
     {
-        MADI_ASSERT(size <= buffer_size_);
+        uint8_t *d = (uint8_t *)dst;
+        uint8_t *s = (uint8_t *)src;
+
+        while (size > 0) {
+            size_t n = (size < buffer_size_) ? size : buffer_size_;
 
-        get(buffer_, src, size, target);
+            get(buffer_, s, n, target);
+            memcpy(d, buffer_, n);
 
-        memcpy(dst, buffer_, size);
+            d += n;
+            s += n;
+            size -= n;
+        }
     }
 
 }
@@ -5,12 +5,44 @@
 
 namespace madi {
 
+    // victim selection policies for work stealing (MADM_VICTIM_POLICY)
+    enum victim_policy {
+        victim_policy_random,       // uniformly random among all processes
+        victim_policy_hierarchical, // intra-node first, remote occasionally
+        victim_policy_affinity,     // retry the last successful victim
+    };
+
+    // remote steal protocols for global_taskque (MADM_STEAL_TYPE)
+    enum steal_type {
+        steal_type_lock,            // lock the victim queue during a steal
+        steal_type_lockfree,        // claim an entry by compare-and-swap
+        steal_type_pipelined,       // unlock before the stack transfer
+    };
+
     struct uth_options {
         size_t stack_size;
         size_t stack_overflow_detection;
         size_t taskq_capacity;
         size_t page_size;
         int    profile_enabled;
+        int    victim_policy;
+        size_t victim_remote_prob;
+        int    steal_type;
+        size_t steal_batch_max;
+        size_t sctx_pool_max;
+        size_t taskq_max_capacity;
+        size_t future_pool_size;
+        size_t future_chunk_size;
+        size_t future_return_batch;
+        size_t waitq_capacity;
+        size_t waitq_buf_size;
+        size_t idle_backoff_min;
+        size_t idle_backoff_max;
+        int    idle_park;
+        int    trace_enabled;
+        size_t trace_buf_size;
+        int    span_profile;
+        size_t span_burden;
     };
 
     extern uth_options uth_options;
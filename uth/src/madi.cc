@@ -1,6 +1,7 @@
 #include "madi-inl.h"
 #include "process-inl.h"
 #include "uni/worker-inl.h"
+#include "reducer.h"
 
 namespace madi {
 
@@ -26,13 +27,157 @@ namespace madi {
         uth_comm& c = madi::proc().com();
         worker& w = madi::current_worker();
 
+        // the idle controller of the worker stops stealing once it
+        // detects that no thread is left in this phase
+        w.idle().begin_drain();
+
+        // the main thread does not advance its strand while it waits
+        span_state s = w.span().fold();
+
         while (!c.barrier_try())
             w.do_scheduler_work();
 
+        w.span().restore(s);
+
+        g_prof->idle_clocks += w.idle().end_drain(c);
+
+        combine_reducers(c);
+
         // update max stack usage
         g_prof->max_stack_usage = w.max_stack_usage();
     }
 
+    // registered reducers, and RDMA buffers for their views. the buffers
+    // are allocated at initialization for namespace-scope reducers, and
+    // grown at a barrier if reducers are constructed later.
+    static reducer_base *g_reducers = NULL;
+    static uint8_t **g_reducer_bufs = NULL;
+    static uint8_t *g_reducer_tmp = NULL;
+    static size_t g_reducer_buf_size = 0;
+
+    reducer_base::reducer_base() :
+        prev_(NULL), next_(g_reducers)
+    {
+        if (g_reducers != NULL)
+            g_reducers->prev_ = this;
+        g_reducers = this;
+    }
+
+    reducer_base::~reducer_base()
+    {
+        if (prev_ != NULL)
+            prev_->next_ = next_;
+        else
+            g_reducers = next_;
+
+        if (next_ != NULL)
+            next_->prev_ = prev_;
+    }
+
+    static size_t reducer_views_size()
+    {
+        size_t size = 0;
+        for (reducer_base *r = g_reducers; r != NULL; r = r->next())
+            size += r->view_size();
+        return size;
+    }
+
+    static void allocate_reducer_bufs(uth_comm& c, size_t size)
+    {
+        g_reducer_bufs = (uint8_t **)c.malloc_shared(size);
+        g_reducer_tmp = (uint8_t *)c.malloc_shared_local(size);
+        g_reducer_buf_size = size;
+    }
+
+    void initialize_reducers(uth_comm& c)
+    {
+        size_t size = reducer_views_size();
+
+        if (size == 0)
+            return;
+
+        allocate_reducer_bufs(c, size);
+    }
+
+    void finalize_reducers(uth_comm& c)
+    {
+        if (g_reducer_buf_size == 0)
+            return;
+
+        c.free_shared((void **)g_reducer_bufs);
+        c.free_shared_local(g_reducer_tmp);
+        g_reducer_bufs = NULL;
+        g_reducer_tmp = NULL;
+        g_reducer_buf_size = 0;
+    }
+
+    // pid 0 combines the views of all processes into its values, and
+    // the others copy the values from pid 0
+    void combine_reducers(uth_comm& c)
+    {
+        if (g_reducers == NULL)
+            return;
+
+        size_t size = reducer_views_size();
+
+        // reducers constructed after the last barrier. every process has
+        // constructed the same ones, so all of them grow the buffers here.
+        if (size > g_reducer_buf_size) {
+            finalize_reducers(c);
+            allocate_reducer_bufs(c, size);
+        }
+
+        madi::pid_t me = c.get_pid();
+        size_t n_procs = c.get_n_procs();
+        uint8_t *buf = g_reducer_bufs[me];
+
+        size_t offset = 0;
+        for (reducer_base *r = g_reducers; r != NULL; r = r->next()) {
+            r->pack_view(buf + offset);
+            offset += r->view_size();
+        }
+
+        c.barrier();
+
+        if (me == 0) {
+            for (madi::pid_t pid = 0; pid < n_procs; pid++) {
+                uint8_t *views = buf;
+                if (pid != me) {
+                    c.get(g_reducer_tmp, g_reducer_bufs[pid], size, pid);
+                    views = g_reducer_tmp;
+                }
+
+                offset = 0;
+                for (reducer_base *r = g_reducers; r != NULL;
+                     r = r->next()) {
+                    r->merge_view(views + offset);
+                    offset += r->view_size();
+                }
+            }
+
+            offset = 0;
+            for (reducer_base *r = g_reducers; r != NULL; r = r->next()) {
+                r->pack_value(buf + offset);
+                offset += r->view_size();
+            }
+        }
+
+        c.barrier();
+
+        if (me != 0) {
+            c.get(g_reducer_tmp, g_reducer_bufs[0], size, 0);
+
+            offset = 0;
+            for (reducer_base *r = g_reducers; r != NULL; r = r->next()) {
+                r->unpack_value(g_reducer_tmp + offset);
+                offset += r->view_size();
+            }
+        }
+
+        // the buffer of pid 0 is not overwritten until the next combine,
+        // which every process enters after the barrier of madi::barrier
+    }
+
     void native_barrier()
     {
         uth_comm& c = madi::proc().com();
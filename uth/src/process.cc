@@ -6,6 +6,7 @@
 #include "madi-inl.h"
 #include "debug.h"
 #include "uth.h"
+#include "reducer.h"
 
 namespace madi {
 
@@ -30,6 +31,8 @@ namespace madi {
 
         MADI_DPUTS2("worker initialized");
 
+        initialize_reducers(self.comm_);
+
         self.initialized_ = true;
 
         MADI_DPUTS2("MassiveThreads/DM system initialized");
@@ -47,6 +50,8 @@ namespace madi {
 
         self.initialized_ = false;
 
+        finalize_reducers(self.comm_);
+
         self.workers_[0].finalize(self.comm_);
 
         MADI_DPUTS2("worker finalized");
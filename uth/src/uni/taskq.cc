@@ -1,6 +1,11 @@
 #include "taskq.h"
 #include "debug.h"
 #include "uth_comm.h"
+#include "uth_options.h"
+
+#include "madi-inl.h"
+#include "process-inl.h"
+#include "taskq-inl.h"
 
 using namespace madi;
 
@@ -15,10 +20,14 @@ void local_taskque::finalize() {
 }
 
 global_taskque::global_taskque() :
-    top_(0), base_(0),
+    top_(0), steal_word_(0),
     n_entries_(0), entries_(NULL),
-    lock_(0)
+    initial_n_entries_(0), max_n_entries_(0), growth_entries_(NULL),
+    n_reserved_(0),
+    lock_(0), lockfree_(false)
 {
+    for (int i = 0; i < MAX_SEGMENTS; i++)
+        segments_[i] = NULL;
 }
 
 global_taskque::~global_taskque()
@@ -26,23 +35,83 @@ global_taskque::~global_taskque()
 }
 
 void global_taskque::initialize(uth_comm& c, taskq_entry *entries,
-                                size_t n_entries)
+                                size_t n_entries,
+                                taskq_entry *growth_entries,
+                                size_t max_n_entries)
 {
-    MADI_CHECK(n_entries <= INT_MAX);
+    MADI_CHECK(max_n_entries <= INT_MAX);
+    MADI_CHECK((n_entries & (n_entries - 1)) == 0);
+    MADI_CHECK(n_entries <= max_n_entries);
     MADI_CHECK(entries != NULL);
+    MADI_CHECK(growth_entries != NULL || n_entries == max_n_entries);
 
-    base_ = (int)n_entries / 2;
-    top_ = base_;
+    steal_word_ = 0;
+    base_ = 0;
+    top_ = 0;
     n_entries_ = (int)n_entries;
     entries_ = entries;
+    initial_n_entries_ = (int)n_entries;
+    max_n_entries_ = (int)max_n_entries;
+    growth_entries_ = growth_entries;
+    n_reserved_ = (int)uth_options.steal_batch_max;
+    lockfree_ = (uth_options.steal_type == steal_type_lockfree);
 
+    segments_[0] = entries;
+    for (int i = 1; i < MAX_SEGMENTS; i++)
+        segments_[i] = NULL;
 }
 
 void global_taskque::finalize(uth_comm& c)
 {
+    for (int i = 0; i < MAX_SEGMENTS; i++)
+        segments_[i] = NULL;
+
     top_ = 0;
-    base_ = 0;
+    steal_word_ = 0;
     n_entries_ = 0;
     entries_ = NULL;
+    initial_n_entries_ = 0;
+    max_n_entries_ = 0;
+    growth_entries_ = NULL;
+}
+
+void global_taskque::grow(int t)
+{
+    int seg = word_segment(steal_word_) + 1;
+    int n_entries = n_entries_ * 2;
+
+    if (seg >= MAX_SEGMENTS || n_entries > max_n_entries_)
+        madi::die("task queue overflow");
+
+    // segments_[i] (i >= 1) is at offset sum_{j=1}^{i-1} initial << j
+    taskq_entry *entries =
+        growth_entries_ + (n_entries - 2 * initial_n_entries_);
+
+    // thieves of the locking protocols read segments_ and the entries
+    // under lock_. lock-free thieves may read the old segment during the
+    // copy, which is never written again.
+    if (!lockfree_)
+        local_lock();
+
+    int b = base_;
+
+    for (int i = b; i < t; i++)
+        entries[i & (n_entries - 1)] = entries_[i & (n_entries_ - 1)];
+
+    segments_[seg] = entries;
+
+    comm::threadsafe::wbarrier();
+
+    // claims on a snapshot of the old segment fail after this
+    comm::threadsafe::fetch_and_add(&steal_word_, segment_unit);
+
+    entries_ = entries;
+    n_entries_ = n_entries;
+
+    if (!lockfree_)
+        local_unlock();
+
+    MADI_DPUTS1("task queue grows to %d entries (segment %d)",
+                n_entries, seg);
 }
 
@@ -10,6 +10,7 @@
 #include "uth_comm-inl.h"
 #include "future-inl.h"
 #include "uni/worker-inl.h"
+#include "uni/waitq-inl.h"
 
 #include <unistd.h>
 
@@ -22,6 +23,8 @@ void madi_worker_do_resume_saved_context(void *p0, void *p1, void *p2,
                                          void *p3);
 void madi_worker_do_resume_remote_context(void *p0, void *p1, void *p2,
                                           void *p3);
+void madi_worker_do_resume_waiting_context(void *p0, void *p1, void *p2,
+                                           void *p3);
 
 }
 
@@ -31,9 +34,20 @@ worker::worker() :
     parent_ctx_(NULL),
     is_main_task_(false),
     taskq_(NULL), taskq_array_(NULL), taskq_entries_array_(NULL),
+    taskq_growth_array_(NULL),
+    gwaitq_(NULL), gwaitq_array_(NULL), gwaitq_entries_array_(NULL),
+    gwaitq_stacks_array_(NULL), gwaitq_buf_(NULL), gwaitq_entry_buf_(NULL),
+    victims_(),
+    idle_(),
+    trace_(),
+    span_(),
     fpool_(),
+    sctx_pool_(),
     main_ctx_(NULL),
     waitq_(),
+    stash_(),
+    wait_id_(-1), wait_pid_(0),
+    current_future_(-1), leap_target_(-1),
     done_(false)
 {
 }
@@ -46,9 +60,20 @@ worker::worker(const worker& sched) :
     parent_ctx_(NULL),
     is_main_task_(false),
     taskq_(), taskq_array_(NULL), taskq_entries_array_(NULL),
+    taskq_growth_array_(NULL),
+    gwaitq_(NULL), gwaitq_array_(NULL), gwaitq_entries_array_(NULL),
+    gwaitq_stacks_array_(NULL), gwaitq_buf_(NULL), gwaitq_entry_buf_(NULL),
+    victims_(),
+    idle_(),
+    trace_(),
+    span_(),
     fpool_(),
+    sctx_pool_(),
     main_ctx_(NULL), 
     waitq_(),
+    stash_(),
+    wait_id_(-1), wait_pid_(0),
+    current_future_(-1), leap_target_(-1),
     done_(false)
 {
 }
@@ -75,45 +100,150 @@ void worker::initialize(uth_comm& c)
 
     MADI_ASSERT(taskq_entries_array[me] != NULL);
 
+    // segments to grow the task queue into: capacities 2n, 4n, ...,
+    // max_n_entries in sequence
+    size_t max_n_entries = madi::uth_options.taskq_max_capacity;
+    size_t growth_size =
+        sizeof(taskq_entry) * 2 * (max_n_entries - n_entries);
+
+    taskq_entry ** taskq_growth_array = NULL;
+    if (growth_size > 0) {
+        taskq_growth_array = (taskq_entry **)c.malloc_shared(growth_size);
+
+        MADI_ASSERT(taskq_growth_array[me] != NULL);
+    }
+
     taskque *taskq_buf =
         (taskque *)c.malloc_shared_local(sizeof(taskque));
 
     MADI_ASSERT(taskq_buf != NULL);
 
+    // a steal-half operation gets up to steal_batch_max entries at once
+    size_t entry_buf_size =
+        sizeof(taskq_entry) * madi::uth_options.steal_batch_max;
+
     taskq_entry *taskq_entry_buf =
-        (taskq_entry *)c.malloc_shared_local(sizeof(taskq_entry));
+        (taskq_entry *)c.malloc_shared_local(entry_buf_size);
 
     MADI_ASSERT(taskq_entry_buf != NULL);
 
     taskque *taskq = new (taskq_array[me]) taskque();
-    taskq->initialize(c, taskq_entries_array[me], n_entries);
+    taskq->initialize(c, taskq_entries_array[me], n_entries,
+                      (taskq_growth_array != NULL)
+                          ? taskq_growth_array[me] : NULL,
+                      max_n_entries);
 
     taskq_ = taskq;
     taskq_array_ = taskq_array;
     taskq_entries_array_ = taskq_entries_array;
+    taskq_growth_array_ = taskq_growth_array;
     taskq_buf_ = taskq_buf;
     taskq_entry_buf_ = taskq_entry_buf;
 
+    // the stealable wait queue. its buffer of partial stacks is allocated
+    // twice as large, and aligned to its size.
+    size_t waitq_n_entries = madi::uth_options.waitq_capacity;
+    size_t waitq_buf_size = madi::uth_options.waitq_buf_size;
+
+    if (c.get_n_procs() == 1)
+        waitq_n_entries = 0;
+
+    global_waitq ** gwaitq_array =
+        (global_waitq **)c.malloc_shared(sizeof(global_waitq));
+
+    MADI_ASSERT(gwaitq_array[me] != NULL);
+
+    waitq_entry ** gwaitq_entries_array = NULL;
+    uint8_t ** gwaitq_stacks_array = NULL;
+    waitq_entry *gwaitq_entries = NULL;
+    uint8_t *gwaitq_stacks = NULL;
+
+    if (waitq_n_entries > 0) {
+        gwaitq_entries_array = (waitq_entry **)
+            c.malloc_shared(sizeof(waitq_entry) * waitq_n_entries);
+        gwaitq_stacks_array = (uint8_t **)
+            c.malloc_shared(2 * waitq_buf_size);
+
+        uintptr_t addr = (uintptr_t)gwaitq_stacks_array[me];
+        addr = (addr + waitq_buf_size - 1) & ~(uintptr_t)(waitq_buf_size - 1);
+
+        gwaitq_entries = gwaitq_entries_array[me];
+        gwaitq_stacks = (uint8_t *)addr;
+    }
+
+    global_waitq *gwaitq = new (gwaitq_array[me]) global_waitq();
+    gwaitq->initialize(c, gwaitq_entries, waitq_n_entries,
+                       gwaitq_stacks, waitq_buf_size);
+
+    global_waitq *gwaitq_buf =
+        (global_waitq *)c.malloc_shared_local(sizeof(global_waitq));
+    waitq_entry *gwaitq_entry_buf =
+        (waitq_entry *)c.malloc_shared_local(sizeof(waitq_entry));
+
+    MADI_ASSERT(gwaitq_buf != NULL);
+    MADI_ASSERT(gwaitq_entry_buf != NULL);
+
+    gwaitq_ = gwaitq;
+    gwaitq_array_ = gwaitq_array;
+    gwaitq_entries_array_ = gwaitq_entries_array;
+    gwaitq_stacks_array_ = gwaitq_stacks_array;
+    gwaitq_buf_ = gwaitq_buf;
+    gwaitq_entry_buf_ = gwaitq_entry_buf;
+
+    victims_.initialize(me, c.get_n_procs());
+    idle_.initialize(c);
+    trace_.initialize();
+    span_.initialize();
+
     MADI_ASSERT(waitq_.size() == 0);
     waitq_.clear();
 
-    size_t future_buf_size = 16 * 1024; //128 * 1024;
-    fpool_.initialize(c, future_buf_size);
+    MADI_ASSERT(stash_.size() == 0);
+    stash_.clear();
+
+    fpool_.initialize(c, madi::uth_options.future_pool_size,
+                      madi::uth_options.future_chunk_size);
+
+    sctx_pool_.initialize(madi::uth_options.sctx_pool_max);
 }
 
 void worker::finalize(uth_comm& c)
 {
+    trace_.finalize(c.get_pid(), c.get_n_procs());
+    span_.report(c);
+    idle_.finalize(c);
     fpool_.finalize(c);
+    sctx_pool_.finalize();
     taskq_->finalize(c);
 
     c.free_shared((void **)taskq_array_);
     c.free_shared((void **)taskq_entries_array_);
+    if (taskq_growth_array_ != NULL)
+        c.free_shared((void **)taskq_growth_array_);
     c.free_shared_local((void *)taskq_buf_);
     c.free_shared_local((void *)taskq_entry_buf_);
 
+    gwaitq_->finalize(c);
+
+    c.free_shared((void **)gwaitq_array_);
+    if (gwaitq_entries_array_ != NULL) {
+        c.free_shared((void **)gwaitq_entries_array_);
+        c.free_shared((void **)gwaitq_stacks_array_);
+    }
+    c.free_shared_local((void *)gwaitq_buf_);
+    c.free_shared_local((void *)gwaitq_entry_buf_);
+
+    gwaitq_ = NULL;
+    gwaitq_array_ = NULL;
+    gwaitq_entries_array_ = NULL;
+    gwaitq_stacks_array_ = NULL;
+    gwaitq_buf_ = NULL;
+    gwaitq_entry_buf_ = NULL;
+
     taskq_ = NULL;
     taskq_array_ = NULL;
     taskq_entries_array_ = NULL;
+    taskq_growth_array_ = NULL;
     taskq_buf_ = NULL;
     taskq_entry_buf_ = NULL;
 }
@@ -144,8 +274,12 @@ void worker_do_start(context *ctx, void *arg0, void *arg1)
     w.is_main_task_ = true;
 
     // execute the start function
+    w.span_.begin_main();
+
     p->init_f(p->argc, p->argv);
 
+    madi::current_worker().span_.end_main();
+
     MADI_DPUTS2("user code in a main thread is finished");
 
     madi::barrier();
@@ -210,33 +344,53 @@ void worker::start(void (*f)(int, char **), int argc, char **argv)
     MADI_DPUTS2("context resumed");
 }
 
-static size_t select_victim_randomly(uth_comm& c)
+bool worker::steal(taskq_entry *entries,
+                   size_t *n_entries,
+                   madi::pid_t *victim,
+                   taskque **taskq_ptr)
 {
-    madi::pid_t me = c.get_pid();
-    size_t n_procs = c.get_n_procs();
+    // there is no victim to select in a single-process run
+    if (madi::proc().com().get_n_procs() == 1)
+        return false;
 
-    madi::pid_t pid;
-    do {
-        pid = (madi::pid_t)random_int((int)n_procs);
-        MADI_CHECK((size_t)pid != n_procs);
-    } while (pid == me);
+    tsc_t t0 = rdtsc();
 
-    return pid;
+    bool success;
+    if (uth_options.steal_type == steal_type_lockfree)
+        success = steal_without_lock(entries, n_entries, victim, taskq_ptr);
+    else
+        success = steal_with_lock(entries, n_entries, victim, taskq_ptr);
+
+    if (success)
+        trace_.record_at(t0, MADI_TRACE_STEAL, (uint32_t)*victim);
+
+    return success;
 }
 
-static size_t select_victim(uth_comm& c)
+madi::pid_t worker::select_victim(bool *leap)
 {
-    return select_victim_randomly(c);
+    // the process running the thread a touched future waits for holds
+    // its descendants most likely
+    long target = leap_target_;
+    leap_target_ = -1;
+
+    *leap = (target >= 0);
+
+    if (*leap)
+        return (madi::pid_t)target;
+    else
+        return victims_.select();
 }
 
-bool worker::steal_with_lock(taskq_entry *entry,
+bool worker::steal_with_lock(taskq_entry *entries_buf,
+                             size_t *n_entries,
                              madi::pid_t *victim,
                              taskque **taskq_ptr)
 {
     uth_comm& c = madi::proc().com();
 
-    size_t target = select_victim(c);
-    taskq_entry *entries = taskq_entries_array_[target];
+    bool leap;
+    madi::pid_t target = select_victim(&leap);
     taskque *taskq = taskq_array_[target];
     
 #define MADI_ABORTING_STEAL 1
@@ -250,6 +404,7 @@ bool worker::steal_with_lock(taskq_entry *entry,
     g_prof->current_steal().empty_check = t1 - t0;
 
     if (do_abort) {
+        victims_.notify_failure(target);
         g_prof->n_aborted_steals += 1;
         return false;
     }
@@ -264,11 +419,24 @@ bool worker::steal_with_lock(taskq_entry *entry,
     g_prof->current_steal().lock = t3 - t2;
 
     if (!success) {
+        victims_.notify_failure(target);
         g_prof->n_failed_steals_lock += 1;
         return false;
     }
 
-    success = taskq->steal(c, target, entries, entry, taskq_buf_);
+    size_t n_stolen;
+    size_t max_entries = uth_options.steal_batch_max;
+    bool pipelined = (uth_options.steal_type == steal_type_pipelined);
+
+    if (max_entries > 1) {
+        n_stolen = taskq->steal_batch(c, target, entries_buf, max_entries,
+                                      taskq_buf_, pipelined);
+        success = n_stolen > 0;
+    } else {
+        n_stolen = 1;
+        success = taskq->steal(c, target, entries_buf, taskq_buf_,
+                               pipelined);
+    }
 
     long t4 = rdtsc();
     g_prof->current_steal().steal = t4 - t3;
@@ -280,19 +448,192 @@ bool worker::steal_with_lock(taskq_entry *entry,
         g_prof->current_steal().unlock = t5 - t4;
         g_prof->n_failed_steals_empty += 1;
 
+        victims_.notify_failure(target);
+
         return false;
     }
 
     g_prof->n_success_steals += 1;
+    g_prof->n_stolen_entries += n_stolen;
+    g_prof->max_stolen_entries =
+        std::max(g_prof->max_stolen_entries, n_stolen);
+    g_prof->current_steal().n_entries = (long)n_stolen;
+
+    if (!victims_.is_local(target))
+        g_prof->n_remote_steals += 1;
 
+    if (leap)
+        g_prof->n_leapfrog_steals += 1;
+
+    victims_.notify_success(target);
+
+    *n_entries = n_stolen;
     *victim = target;
     *taskq_ptr = taskq;  // for unlock when task stack is transfered
     return true;
 }
 
-void resume_context(saved_context *sctx, context *ctx)
+bool worker::steal_without_lock(taskq_entry *entry,
+                                size_t *n_entries,
+                                madi::pid_t *victim,
+                                taskque **taskq_ptr)
+{
+    uth_comm& c = madi::proc().com();
+
+    bool leap;
+    madi::pid_t target = select_victim(&leap);
+    taskque *taskq = taskq_array_[target];
+
+    long t0 = rdtsc();
+
+    // the snapshot of the victim queue is also used to claim an entry
+    bool do_abort = taskq->empty(c, target, taskq_buf_);
+
+    long t1 = rdtsc();
+    g_prof->current_steal().empty_check = t1 - t0;
+    g_prof->current_steal().lock = 0;
+
+    if (do_abort) {
+        victims_.notify_failure(target);
+        g_prof->n_aborted_steals += 1;
+        return false;
+    }
+
+    bool contended;
+    bool success = taskq->steal_lockfree(c, target, entry, taskq_buf_,
+                                         &contended);
+
+    long t2 = rdtsc();
+    g_prof->current_steal().steal = t2 - t1;
+
+    if (!success) {
+        victims_.notify_failure(target);
+
+        // a lost race for the claim is counted as lock contention
+        if (contended)
+            g_prof->n_failed_steals_lock += 1;
+        else
+            g_prof->n_failed_steals_empty += 1;
+
+        return false;
+    }
+
+    g_prof->n_success_steals += 1;
+    g_prof->n_stolen_entries += 1;
+    g_prof->max_stolen_entries = std::max(g_prof->max_stolen_entries,
+                                          (size_t)1);
+    g_prof->current_steal().n_entries = 1;
+
+    if (!victims_.is_local(target))
+        g_prof->n_remote_steals += 1;
+
+    if (leap)
+        g_prof->n_leapfrog_steals += 1;
+
+    victims_.notify_success(target);
+
+    *n_entries = 1;
+    *victim = target;
+    *taskq_ptr = taskq;  // for release when task stack is transfered
+    return true;
+}
+
+void worker::put_suspended(saved_context *sctx)
+{
+    int wait_id = wait_id_;
+    wait_id_ = -1;
+
+    // a thread waiting for a future sleeps on the future entry until
+    // the filler of the entry moves it back to waitq_. the main task keeps
+    // polling so that it is always on the stack or in waitq_ (see go()).
+    if (wait_id >= 0 && !sctx->is_main_task) {
+        if (fpool_.add_waiter(wait_id, wait_pid_, sctx))
+            return;
+    }
+
+    waitq_.push_back(sctx);
+}
+
+bool worker::steal_waiting(waitq_entry **entry, uint8_t **stack,
+                           madi::pid_t *victim, global_waitq **waitq_ptr)
+{
+    if (!gwaitq_->enabled())
+        return false;
+
+    uth_comm& c = madi::proc().com();
+
+    madi::pid_t target = victims_.select();
+    global_waitq *waitq = gwaitq_array_[target];
+
+    if (waitq->empty(c, target, gwaitq_buf_)) {
+        // ask the target to export one of its ready threads
+        if (gwaitq_buf_->enabled() && !gwaitq_buf_->wanted())
+            waitq->want(c, target);
+        return false;
+    }
+
+    if (!waitq->steal_trylock(c, target))
+        return false;
+
+    if (!waitq->steal(c, target, gwaitq_entry_buf_, gwaitq_buf_)) {
+        waitq->steal_unlock(c, target);
+        return false;
+    }
+
+    *entry = gwaitq_entry_buf_;
+    *stack = global_waitq::stack_of(*gwaitq_entry_buf_, gwaitq_buf_);
+    *victim = target;
+    *waitq_ptr = waitq;  // for unlock when the stack is transferred
+    return true;
+}
+
+void worker::export_waiting()
+{
+    // only when an idle process has failed to steal from this one, and
+    // one thread for each such request. the thread to run next and the
+    // main task stay in this process.
+    if (!gwaitq_->enabled() || !gwaitq_->wanted())
+        return;
+
+    if (waitq_.size() > 1 && !waitq_.back()->is_main_task) {
+        saved_context *sctx = waitq_.back();
+
+        if (!gwaitq_->push(sctx))
+            return;
+
+        waitq_.pop_back();
+
+        size_t size = offsetof(saved_context, partial_stack) +
+                      sctx->stack_size;
+        sctx_pool_.deallocate((void *)sctx, size);
+
+        g_prof->n_waitq_exports += 1;
+    }
+}
+
+bool worker::import_waiting()
+{
+    if (gwaitq_->local_empty())
+        return false;
+
+    // take back a thread no other process has stolen
+    saved_context *sctx = gwaitq_->pop(sctx_pool_);
+
+    if (sctx == NULL)
+        return false;
+
+    waitq_.push_back(sctx);
+    return true;
+}
+
+void resume_context(saved_context *sctx, context *ctx, long future)
 {
-    madi::current_worker().waitq().push_back(sctx);
+    worker& w = madi::current_worker();
+
+    w.put_suspended(sctx);
+    w.current_future_ = future;
+
+    w.trace_.record(MADI_TRACE_RESUME);
 
     MADI_RESUME_CONTEXT(ctx);
 }
@@ -302,10 +643,12 @@ void resume_saved_context(saved_context *sctx, saved_context *next_sctx)
     worker& w = madi::current_worker();
 
     if (sctx != NULL)
-        w.waitq().push_back(sctx);
+        w.put_suspended(sctx);
 
     w.is_main_task_ = next_sctx->is_main_task;
 
+    w.trace_.record(MADI_TRACE_RESUME);
+
     uint8_t *next_stack_top = (uint8_t *)next_sctx->sp - 128;
 
     MADI_EXECUTE_ON_STACK(madi_worker_do_resume_saved_context,
@@ -314,7 +657,7 @@ void resume_saved_context(saved_context *sctx, saved_context *next_sctx)
 }
 
 void resume_remote_context(saved_context *sctx, 
-                           std::tuple<taskq_entry *, madi::pid_t,
+                           std::tuple<taskq_entry *, size_t, madi::pid_t,
                                       taskque *, tsc_t> *arg)
 /*
                            taskq_entry* entry,
@@ -322,30 +665,76 @@ void resume_remote_context(saved_context *sctx,
                            taskque *taskq)
 */
 {
-    long t0 = std::get<3>(*arg);
+    long t0 = std::get<4>(*arg);
     long t1 = rdtsc();
     g_prof->current_steal().suspend = t1 - t0;
 
-    std::get<3>(*arg) = t1;
+    std::get<4>(*arg) = t1;
 
-    taskq_entry *entry = std::get<0>(*arg);
+    taskq_entry *entries = std::get<0>(*arg);
+    size_t n_entries = std::get<1>(*arg);
 
     worker& w = madi::current_worker();
 
     MADI_ASSERT(sctx != NULL);
 
-    w.waitq().push_back(sctx);
+    w.put_suspended(sctx);
 
     w.is_main_task_ = false;
 
-    uint8_t *next_stack_top = (uint8_t *)entry->frame_base;
+    // stolen entries are nested frames of a task; execute the transfer
+    // below the deepest one.
+    uint8_t *next_stack_top = entries[0].frame_base;
+    for (size_t i = 1; i < n_entries; i++)
+        next_stack_top = std::min(next_stack_top, entries[i].frame_base);
+
     MADI_EXECUTE_ON_STACK(madi_worker_do_resume_remote_context,
                           sctx, arg, NULL, NULL,
                           next_stack_top);
 }
 
+void resume_waiting_context(saved_context *sctx,
+                            std::tuple<waitq_entry *, uint8_t *, madi::pid_t,
+                                       global_waitq *> *arg)
+{
+    worker& w = madi::current_worker();
+
+    MADI_ASSERT(sctx != NULL);
+
+    w.put_suspended(sctx);
+
+    w.is_main_task_ = false;
+
+    // the partial stack is copied to the same address as on the victim
+    waitq_entry *entry = std::get<0>(*arg);
+    uint8_t *next_stack_top = (uint8_t *)entry->sp - 128;
+
+    MADI_EXECUTE_ON_STACK(madi_worker_do_resume_waiting_context,
+                          sctx, arg, NULL, NULL,
+                          next_stack_top);
+}
+
+void worker::do_scheduler_work(int wait_id, madi::pid_t wait_pid,
+                               madi::pid_t runner)
+{
+    madi::pid_t me = madi::proc().com().get_pid();
+
+    wait_id_ = wait_id;
+    wait_pid_ = wait_pid;
+    leap_target_ = (runner != me) ? (long)runner : -1;
+
+    do_scheduler_work();
+
+    // they are left set if no thread switch or steal happened
+    worker& w = madi::current_worker();
+    w.wait_id_ = -1;
+    w.leap_target_ = -1;
+}
+
 void worker::do_scheduler_work()
 {
+    fpool_.move_back_woken_threads();
+
     taskq_entry *entry = taskq_->pop();
 
     MADI_UTH_COMM_POLL();
@@ -354,14 +743,22 @@ void worker::do_scheduler_work()
         // switch to the parent task
         MADI_ASSERT(!is_main_task_);
         MADI_DPUTSB2("resuming the parent task");
-        suspend(resume_context, entry->ctx);
+        suspend(resume_context, entry->ctx, entry->future);
     } else if (!is_main_task_ && main_ctx_ != NULL) {
         // if this task is not the main task,
         // and the main task is not suspended (the frames are on the stack),
         // switch to the main task
         is_main_task_ = true;
         MADI_DPUTSB2("resuming the main task");
-        suspend(resume_context, main_ctx_);
+        suspend(resume_context, main_ctx_, -1L);
+    } else if (!stash_.empty()) {
+        main_ctx_ = NULL;
+
+        // switch to a task stolen together with the previous steal
+        MADI_DPUTSB2("resuming a stashed task");
+        saved_context *sctx = stash_.front();
+        stash_.pop_front();
+        suspend(resume_saved_context, sctx);
     } else {
 //        MADI_ASSERT(is_main_task_);
 
@@ -369,9 +766,25 @@ void worker::do_scheduler_work()
 
         madi::pid_t victim;
 
-        taskq_entry& stolen_entry = *taskq_entry_buf_;
+        taskq_entry *stolen_entries = taskq_entry_buf_;
+        size_t n_entries;
         taskque *taskq;
-        bool success = steal_with_lock(&stolen_entry, &victim, &taskq);
+        waitq_entry *wentry;
+        uint8_t *wstack;
+        global_waitq *victim_waitq;
+
+        // idle workers back off between failed rounds of steals, but a
+        // thread touching a future steals from its runner right away
+        uth_comm& c = madi::proc().com();
+        bool terminated = false;
+        bool may_steal = leap_target_ != -1
+                       || idle_.may_steal(c, &terminated);
+
+        if (!may_steal && terminated)
+            g_prof->n_terminations += 1;
+
+        bool success = may_steal &&
+            steal(stolen_entries, &n_entries, &victim, &taskq);
 
         if (success) {
             // next_steal() is called when stolen thread resumed.
@@ -383,35 +796,81 @@ void worker::do_scheduler_work()
         if (success) {
 
             main_ctx_ = NULL;
+            leave_idle();
 
             // switch to the stolen task
             MADI_DPUTSB2("resuming a stolen task");
 
             tsc_t t = rdtsc();
 
-            std::tuple<taskq_entry *, madi::pid_t, taskque *, tsc_t> 
-                arg(&stolen_entry, victim, taskq, t);
+            std::tuple<taskq_entry *, size_t, madi::pid_t, taskque *, tsc_t> 
+                arg(stolen_entries, n_entries, victim, taskq, t);
 
             suspend(resume_remote_context, &arg);
-        } else if (!waitq_.empty()) {
+        } else if (!waitq_.empty() || import_waiting()) {
             main_ctx_ = NULL;
+            leave_idle();
+
+            // another ready thread can be stolen while this one runs
+            export_waiting();
 
             // switch to a waiting task
             MADI_DPUTSB2("resuming a waiting task");
             saved_context *sctx = waitq_.front();
             waitq_.pop_front();
             suspend(resume_saved_context, sctx);
+        } else if (may_steal && steal_waiting(&wentry, &wstack, &victim,
+                                              &victim_waitq)) {
+            main_ctx_ = NULL;
+            leave_idle();
+
+            // switch to a waiting task of another process
+            MADI_DPUTSB2("resuming a migrated waiting task");
+
+            std::tuple<waitq_entry *, uint8_t *, madi::pid_t,
+                       global_waitq *> arg(wentry, wstack, victim,
+                                               victim_waitq);
+
+            suspend(resume_waiting_context, &arg);
         } else {
-            // do nothing
+            // nothing to run; let the owners reuse the touched futures
+            fpool_.flush_returns();
+
+            if (may_steal) {
+                trace_.record_idle();
+
+                if (idle_.notify_failure(c, can_park()))
+                    g_prof->n_parks += 1;
+            }
         }
     }
 }
 
+// a worker can park only if no thread other than the main task waiting
+// in madi::barrier is left on it
+bool worker::can_park()
+{
+    return is_main_task_ && stash_.empty() && waitq_.empty()
+        && gwaitq_->local_empty() && fpool_.n_waiters() == 0;
+}
+
+void worker::leave_idle()
+{
+    g_prof->idle_clocks += idle_.notify_work(madi::proc().com());
+}
+
 void worker::notify_done()
 {
     done_ = true;
 }
 
+// a thief runs the thread which fills the future from now on
+static void record_runner(worker& w, long future)
+{
+    if (future != -1)
+        w.fpool().set_runner(future, madi::proc().com().get_pid());
+}
+
 }
 
 extern "C" {
@@ -455,7 +914,11 @@ void madi_worker_do_resume_saved_context(void *p0, void *p1, void *p2, void *p3)
     MADI_ASSERT(sctx->ip == ctx->instr_ptr());
     MADI_ASSERT(sctx->sp == ctx->stack_ptr());
 
-    free((void *)sctx);
+    worker& w = madi::current_worker();
+    w.set_current_future(sctx->future);
+
+    size_t sctx_size = offsetof(saved_context, partial_stack) + frame_size;
+    w.sctx_pool().deallocate((void *)sctx, sctx_size);
 
     MADI_DPUTSR2("resuming  [%p, %p) (size = %zu) (waiting)",
                  frame_base, frame_base + frame_size, frame_size);
@@ -463,6 +926,57 @@ void madi_worker_do_resume_saved_context(void *p0, void *p1, void *p2, void *p3)
     madi_resume_context(ctx);
 }
 
+__attribute__((noinline))
+void madi_worker_do_resume_waiting_context(void *p0, void *p1, void *p2,
+                                           void *p3)
+{
+    MADI_DEBUG3( saved_context *prev_sctx = (saved_context *)p0 );
+
+    std::tuple<waitq_entry *, uint8_t *, madi::pid_t, global_waitq *>& arg =
+        *(std::tuple<waitq_entry *, uint8_t *, madi::pid_t,
+                     global_waitq *> *)p1;
+
+    // the entry is in the RMA buffer of the worker, not on the stack
+    waitq_entry entry = *std::get<0>(arg);
+    uint8_t *remote_stack = std::get<1>(arg);
+    madi::pid_t victim = std::get<2>(arg);
+    global_waitq *waitq = std::get<3>(arg);
+
+    uth_comm& c = madi::proc().com();
+
+    MADI_DEBUG3({
+        memset(prev_sctx->stack_top, 1, prev_sctx->stack_size);
+    });
+
+    uint8_t *frame_base = entry.stack_top;
+    size_t frame_size = entry.stack_size;
+
+    c.get(frame_base, remote_stack, frame_size, victim);
+
+    // the victim reuses the buffer after this
+    waitq->steal_unlock(c, victim);
+
+    context *ctx = entry.ctx;
+
+    MADI_CONTEXT_PRINT(2, ctx);
+    MADI_CONTEXT_ASSERT(ctx);
+
+    MADI_ASSERT(entry.ip == ctx->instr_ptr());
+    MADI_ASSERT(entry.sp == ctx->stack_ptr());
+
+    worker& w = madi::current_worker();
+    record_runner(w, entry.future);
+    w.set_current_future(entry.future);
+    w.trace().record(MADI_TRACE_RESUME_STOLEN, (uint32_t)victim);
+
+    g_prof->n_waitq_migrations += 1;
+
+    MADI_DPUTSR1("resuming  [%p, %p) (size = %zu) (migrated from %zu)",
+                 frame_base, frame_base + frame_size, frame_size, victim);
+
+    madi_resume_context(ctx);
+}
+
 static void print(uint8_t *p)
 {
     MADI_DPUTS("p = %p", p);
@@ -495,12 +1009,20 @@ void madi_worker_do_resume_remote_context_1(uth_comm& c,
     e.me = c.get_pid();
     e.victim = victim;
 
-    taskq->steal_unlock(c, victim);
+    // the lock of a pipelined steal has been released already
+    if (uth_options.steal_type == steal_type_lock)
+        taskq->steal_unlock(c, victim);
+    else
+        taskq->steal_release(c, victim);
 
     long t2 = rdtsc();
     e.unlock = t2 - t1;
     e.tmp = t2;
 
+    worker& w = madi::current_worker();
+    w.set_current_future(entry->future);
+    w.trace().record(MADI_TRACE_RESUME_STOLEN, (uint32_t)victim);
+
     MADI_DPUTSR1("resuming  [%p, %p) (size = %zu) (stolen)",
                  frame_base, frame_base + frame_size, frame_size);
 
@@ -517,20 +1039,34 @@ void madi_worker_do_resume_remote_context(void *p0, void *p1, void *p2,
 
     MADI_DEBUG3( saved_context *prev_sctx = (saved_context *)p0 );
 
-    std::tuple<taskq_entry *, madi::pid_t, taskque *, tsc_t>& arg =
-       *(std::tuple<taskq_entry *, madi::pid_t, taskque *, tsc_t> *)p1;
+    std::tuple<taskq_entry *, size_t, madi::pid_t, taskque *, tsc_t>& arg =
+       *(std::tuple<taskq_entry *, size_t, madi::pid_t, taskque *, tsc_t> *)p1;
    
-    taskq_entry entry = *std::get<0>(arg);
-    madi::pid_t victim = std::get<1>(arg);
-    taskque *taskq = std::get<2>(arg);
-    tsc_t t0 = std::get<3>(arg);
+    // entries are in the RMA buffer of the worker, not on the stack
+    taskq_entry *entries = std::get<0>(arg);
+    size_t n_entries = std::get<1>(arg);
+    madi::pid_t victim = std::get<2>(arg);
+    taskque *taskq = std::get<3>(arg);
+    tsc_t t0 = std::get<4>(arg);
+
+    taskq_entry entry = entries[0];
    
     iso_space& ispace = madi::proc().ispace();
     uth_comm& c = madi::proc().com();
     madi::pid_t me = c.get_pid();
 
+    // frames of the entries stolen at once are nested in a call stack,
+    // so they are transferred as one region.
     uint8_t *frame_base = (uint8_t *)entry.frame_base;
-    size_t frame_size = entry.frame_size;
+    uint8_t *frame_end = frame_base + entry.frame_size;
+
+    for (size_t i = 1; i < n_entries; i++) {
+        frame_base = std::min(frame_base, entries[i].frame_base);
+        frame_end = std::max(frame_end,
+                             entries[i].frame_base + entries[i].frame_size);
+    }
+
+    size_t frame_size = frame_end - frame_base;
 
     MADI_DPUTSR1("RDMA region [%p, %p) (size = %zu)",
                 frame_base, (uint8_t *)frame_base + frame_size,
@@ -565,9 +1101,30 @@ void madi_worker_do_resume_remote_context(void *p0, void *p1, void *p2,
 #if MADI_SHMEM
     memcpy(frame_base, remote_base, frame_size);
 #else
-    c.reg_get(local_base, remote_base, frame_size, victim);
+    if (uth_options.steal_type == steal_type_pipelined) {
+        // overlap the unlock with the stack transfer. the victim waits
+        // for this thief in steal_word_ before it reuses the frames.
+        comm::rma_handle h =
+            c.reg_get_nbi(local_base, remote_base, frame_size, victim);
+        taskq->steal_unlock(c, victim);
+        c.wait(h);
+    } else {
+        c.reg_get(local_base, remote_base, frame_size, victim);
+    }
 #endif
 
+    // resume the oldest entry. the others are packed before their frames
+    // are overwritten, and resumed from the stash without another steal.
+    worker& w = madi::current_worker();
+    for (size_t i = 1; i < n_entries; i++) {
+        saved_context *sctx = NULL;
+        MADI_THREAD_PACK(entries[i].ctx, false, entries[i].future, &sctx);
+        w.stash().push_back(sctx);
+    }
+
+    for (size_t i = 0; i < n_entries; i++)
+        record_runner(w, entries[i].future);
+
     madi_worker_do_resume_remote_context_1(c, victim, taskq, &entry,
                                            t0);
 }
@@ -101,6 +101,17 @@ namespace madi {
         return comm::fetch_and_add<int>(dst, value, target);
     }
 
+    long uth_comm::fetch_and_add(long *dst, long value, madi::pid_t target)
+    {
+        return comm::fetch_and_add<long>(dst, value, target);
+    }
+
+    bool uth_comm::compare_and_swap(long *dst, long old_v, long new_v,
+                                    madi::pid_t target)
+    {
+        return comm::compare_and_swap<long>(dst, old_v, new_v, target);
+    }
+
     void ** uth_comm::reg_mmap_shared(void *addr, size_t size)
     {
         // NOTE: this function can be called at a time
@@ -177,6 +188,24 @@ namespace madi {
         comm::reg_get(rdma_id_, dst, src, size, target);
     }
 
+    comm::rma_handle uth_comm::reg_get_nbi(void *dst, void *src, size_t size,
+                                           madi::pid_t target)
+    {
+        MADI_ASSERT(rdma_id_ != -1);
+
+        return comm::reg_get_nbi(rdma_id_, dst, src, size, target);
+    }
+
+    void uth_comm::wait(const comm::rma_handle& h)
+    {
+        comm::wait(h);
+    }
+
+    void uth_comm::fence()
+    {
+        comm::fence();
+    }
+
     void uth_comm::barrier()
     {
         comm::barrier();
@@ -377,6 +406,23 @@ int uth_comm::fetch_and_add(int *dst, int value, madi::pid_t target)
     return result;
 }
 
+long uth_comm::fetch_and_add(long *dst, long value, madi::pid_t target)
+{
+    long result;
+
+    ARMCI_Rmw(ARMCI_FETCH_AND_ADD_LONG, &result, dst, value, (int)target);
+    ARMCI_Fence((int)target);
+
+    return result;
+}
+
+bool uth_comm::compare_and_swap(long *dst, long old_v, long new_v,
+                                madi::pid_t target)
+{
+    // ARMCI does not provide remote compare-and-swap
+    MADI_UNDEFINED;
+}
+
 void ** uth_comm::reg_mmap_shared(void *addr, size_t size)
 {
     return rdma_.reg_mmap_shared(addr, size);
@@ -397,6 +443,23 @@ void uth_comm::reg_get(void *dst, void *src, size_t size, madi::pid_t target)
     rdma_.reg_get(dst, src, size, target);
 }
 
+comm::rma_handle uth_comm::reg_get_nbi(void *dst, void *src, size_t size,
+                                       madi::pid_t target)
+{
+    // completes immediately
+    rdma_.reg_get(dst, src, size, target);
+    return comm::rma_handle::completed();
+}
+
+void uth_comm::wait(const comm::rma_handle& h)
+{
+}
+
+void uth_comm::fence()
+{
+    ARMCI_AllFence();
+}
+
 void uth_comm::barrier()
 {
 #if 0
@@ -1,5 +1,7 @@
 #include "uth_options.h"
+#include "debug.h"
 #include <cstdlib>
+#include <cstring>
 #include <unistd.h>
 
 namespace madi {
@@ -11,6 +13,24 @@ namespace madi {
         1024,               // taskq_capacity
         8192,               // page_size
         0,                  // profile_enabled
+        victim_policy_random, // victim_policy
+        10,                 // victim_remote_prob (%)
+        steal_type_lock,    // steal_type
+        1,                  // steal_batch_max
+        4 * 1024 * 1024,    // sctx_pool_max (bytes)
+        16 * 1024,          // taskq_max_capacity
+        4 * 1024 * 1024,    // future_pool_size (bytes)
+        64 * 1024,          // future_chunk_size (bytes)
+        32,                 // future_return_batch
+        256,                // waitq_capacity
+        1024 * 1024,        // waitq_buf_size (bytes)
+        512,                // idle_backoff_min (clocks)
+        64 * 1024,          // idle_backoff_max (clocks)
+        1,                  // idle_park
+        0,                  // trace_enabled
+        1024 * 1024,        // trace_buf_size (events)
+        0,                  // span_profile
+        15000,              // span_burden (clocks)
     };
 
     template <class T>
@@ -32,12 +52,135 @@ namespace madi {
         }
     }
 
+    void set_victim_policy(const char *name, int *value)
+    {
+        char *s = getenv(name);
+
+        if (s == NULL)
+            return;
+
+        if (strcmp(s, "random") == 0)
+            *value = victim_policy_random;
+        else if (strcmp(s, "hier") == 0 || strcmp(s, "hierarchical") == 0)
+            *value = victim_policy_hierarchical;
+        else if (strcmp(s, "affinity") == 0)
+            *value = victim_policy_affinity;
+        else
+            MADI_DIE("unknown victim policy `%s' "
+                     "(random, hier, or affinity)", s);
+    }
+
+    void set_steal_type(const char *name, int *value)
+    {
+        char *s = getenv(name);
+
+        if (s == NULL)
+            return;
+
+        if (strcmp(s, "lock") == 0)
+            *value = steal_type_lock;
+        else if (strcmp(s, "lockfree") == 0)
+            *value = steal_type_lockfree;
+        else if (strcmp(s, "pipelined") == 0)
+            *value = steal_type_pipelined;
+        else
+            MADI_DIE("unknown steal type `%s' "
+                     "(lock, lockfree, or pipelined)", s);
+    }
+
     void uth_options_initialize()
     {
         set_option("MADM_STACK_SIZE", &uth_options.stack_size);
         set_option("MADM_STACK_DETECT", &uth_options.stack_overflow_detection);
         set_option("MADM_TASKQ_CAPACITY", &uth_options.taskq_capacity);
         set_option("MADM_PROFILE", &uth_options.profile_enabled);
+        set_victim_policy("MADM_VICTIM_POLICY", &uth_options.victim_policy);
+        set_option("MADM_VICTIM_REMOTE_PROB",
+                   &uth_options.victim_remote_prob);
+        set_steal_type("MADM_STEAL_TYPE", &uth_options.steal_type);
+        set_option("MADM_STEAL_BATCH", &uth_options.steal_batch_max);
+        set_option("MADM_SCTX_POOL_SIZE", &uth_options.sctx_pool_max);
+        set_option("MADM_TASKQ_MAX_CAPACITY",
+                   &uth_options.taskq_max_capacity);
+        set_option("MADM_FUTURE_POOL_SIZE", &uth_options.future_pool_size);
+        set_option("MADM_FUTURE_CHUNK_SIZE", &uth_options.future_chunk_size);
+        set_option("MADM_FUTURE_RETURN_BATCH",
+                   &uth_options.future_return_batch);
+        set_option("MADM_WAITQ_CAPACITY", &uth_options.waitq_capacity);
+        set_option("MADM_WAITQ_BUF_SIZE", &uth_options.waitq_buf_size);
+        set_option("MADM_IDLE_BACKOFF_MIN", &uth_options.idle_backoff_min);
+        set_option("MADM_IDLE_BACKOFF_MAX", &uth_options.idle_backoff_max);
+        set_option("MADM_IDLE_PARK", &uth_options.idle_park);
+        set_option("MADM_TRACE", &uth_options.trace_enabled);
+        set_option("MADM_TRACE_SIZE", &uth_options.trace_buf_size);
+        set_option("MADM_SPAN_PROFILE", &uth_options.span_profile);
+        set_option("MADM_SPAN_BURDEN", &uth_options.span_burden);
+
+        // the task queue is a ring buffer indexed by a bit mask, and
+        // grows by doubling up to taskq_max_capacity
+        size_t n_entries = 1;
+        while (n_entries < uth_options.taskq_capacity)
+            n_entries *= 2;
+        uth_options.taskq_capacity = n_entries;
+
+        while (n_entries < uth_options.taskq_max_capacity)
+            n_entries *= 2;
+        uth_options.taskq_max_capacity = n_entries;
+
+        // future ids are (chunk index, offset) pairs packed in an int
+        size_t chunk_size = 256;
+        while (chunk_size < uth_options.future_chunk_size &&
+               chunk_size < (4UL << 20))
+            chunk_size *= 2;
+        uth_options.future_chunk_size = chunk_size;
+
+        // the whole pool is allocated, registered and prefaulted on every
+        // process at startup, and the shmem layer maps the pools of all
+        // processes on a node. so the default is kept at 4 MB, which holds
+        // 128Ki outstanding futures of word-sized values (32-byte entries)
+        // per process. programs that keep more of them outstanding raise
+        // MADM_FUTURE_POOL_SIZE.
+        size_t pool_size = uth_options.future_pool_size;
+        pool_size = (pool_size + chunk_size - 1) / chunk_size * chunk_size;
+        if (pool_size < chunk_size)
+            pool_size = chunk_size;
+        if (pool_size > (1UL << 30))
+            pool_size = 1UL << 30;
+        uth_options.future_pool_size = pool_size;
+
+        // the stealable wait queue is a ring buffer of waitq_capacity
+        // entries (0 disables it), and its buffer of partial stacks is
+        // aligned to its size so that it lies in one RDMA window
+        if (uth_options.waitq_capacity > 0) {
+            n_entries = 1;
+            while (n_entries < uth_options.waitq_capacity)
+                n_entries *= 2;
+            uth_options.waitq_capacity = n_entries;
+
+            size_t buf_size = 4096;
+            while (buf_size < uth_options.waitq_buf_size &&
+                   buf_size < (4UL << 20))
+                buf_size *= 2;
+            uth_options.waitq_buf_size = buf_size;
+        }
+
+        // returned future ids are sent to the owner in batches of this
+        // size, which must fit in the return ring of the owner
+        if (uth_options.future_return_batch == 0)
+            uth_options.future_return_batch = 1;
+        if (uth_options.future_return_batch > 1024)
+            uth_options.future_return_batch = 1024;
+
+        // idle workers back off between failed steals from
+        // idle_backoff_min to idle_backoff_max clocks (0 disables it)
+        if (uth_options.idle_backoff_min > uth_options.idle_backoff_max)
+            uth_options.idle_backoff_min = uth_options.idle_backoff_max;
+
+        if (uth_options.steal_batch_max == 0)
+            uth_options.steal_batch_max = 1;
+
+        if (uth_options.victim_remote_prob > 100)
+            uth_options.victim_remote_prob = 100;
 
         long page_size = sysconf(_SC_PAGE_SIZE);
         uth_options.page_size = static_cast<size_t>(page_size);
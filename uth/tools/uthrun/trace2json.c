@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sysexits.h>
+
+/* converts trace.%03zu.bin files written with MADM_TRACE=1 to Chrome
+   trace JSON (chrome://tracing, Perfetto) with one track per process */
+#include "trace.h"
+
+struct trace_file {
+    struct madi_trace_header h;
+    struct madi_trace_event *events;
+};
+
+static int read_trace(const char *fname, struct trace_file *t)
+{
+    FILE *fp = fopen(fname, "rb");
+    if (fp == NULL) {
+        perror(fname);
+        return 0;
+    }
+
+    if (fread(&t->h, sizeof(t->h), 1, fp) != 1
+        || t->h.magic != MADI_TRACE_MAGIC) {
+        fprintf(stderr, "%s: not a trace file\n", fname);
+        fclose(fp);
+        return 0;
+    }
+
+    t->events = malloc(sizeof(struct madi_trace_event) * (t->h.n_events + 1));
+    if (fread(t->events, sizeof(struct madi_trace_event), t->h.n_events, fp)
+        != t->h.n_events) {
+        fprintf(stderr, "%s: truncated\n", fname);
+        fclose(fp);
+        return 0;
+    }
+
+    fclose(fp);
+    return 1;
+}
+
+/* the state of the worker after an event, or NULL if it does not change */
+static const char *state_after(uint32_t type)
+{
+    switch (type) {
+    case MADI_TRACE_DIE:
+    case MADI_TRACE_SUSPEND:        return "sched";
+    case MADI_TRACE_RESUME:
+    case MADI_TRACE_RESUME_STOLEN:
+    case MADI_TRACE_TOUCH_END:      return "run";
+    case MADI_TRACE_STEAL:          return "steal";
+    case MADI_TRACE_IDLE:           return "idle";
+    case MADI_TRACE_TOUCH_BEGIN:    return "touch";
+    default:                        return NULL;
+    }
+}
+
+static int first_event = 1;
+
+static void begin_event(void)
+{
+    printf("%s\n    ", first_event ? "" : ",");
+    first_event = 0;
+}
+
+static void convert(const struct trace_file *t, int64_t base_ns,
+                    int with_forks)
+{
+    const struct madi_trace_header *h = &t->h;
+    double offset_us = (double)(h->start_ns - base_ns) / 1000.0;
+    double clocks_per_us = h->clocks_per_ns * 1000.0;
+
+    begin_event();
+    printf("{\"ph\": \"M\", \"pid\": %llu, \"name\": \"process_name\", "
+           "\"args\": {\"name\": \"process %llu\"}}",
+           (unsigned long long)h->pid, (unsigned long long)h->pid);
+
+    if (h->n_dropped > 0)
+        fprintf(stderr, "process %llu: %llu oldest events dropped "
+                "(increase MADM_TRACE_SIZE)\n",
+                (unsigned long long)h->pid,
+                (unsigned long long)h->n_dropped);
+
+    if (h->n_events == 0)
+        return;
+
+    /* the main thread runs from the start unless events are dropped */
+    const char *state = (h->n_dropped == 0) ? "run" : NULL;
+    double state_ts = offset_us;
+    uint32_t state_arg = 0;
+    int has_arg = 0;
+
+    size_t i;
+    for (i = 0; i < h->n_events; i++) {
+        const struct madi_trace_event *e = &t->events[i];
+        double ts = offset_us + (double)(e->tsc - h->start_tsc) / clocks_per_us;
+
+        if (e->type == MADI_TRACE_FORK) {
+            if (with_forks) {
+                begin_event();
+                printf("{\"ph\": \"i\", \"pid\": %llu, \"tid\": 0, "
+                       "\"name\": \"fork\", \"s\": \"t\", \"ts\": %.3f}",
+                       (unsigned long long)h->pid, ts);
+            }
+            continue;
+        }
+
+        const char *next = state_after(e->type);
+        if (next == NULL || (state != NULL && strcmp(next, state) == 0))
+            continue;
+
+        if (state != NULL && ts > state_ts) {
+            begin_event();
+            printf("{\"ph\": \"X\", \"pid\": %llu, \"tid\": 0, "
+                   "\"name\": \"%s\", \"ts\": %.3f, \"dur\": %.3f",
+                   (unsigned long long)h->pid, state, state_ts,
+                   ts - state_ts);
+            if (has_arg)
+                printf(", \"args\": {\"victim\": %u}", state_arg);
+            printf("}");
+        }
+
+        state = next;
+        state_ts = ts;
+        state_arg = e->arg;
+        has_arg = (e->type == MADI_TRACE_STEAL
+                   || e->type == MADI_TRACE_RESUME_STOLEN);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int with_forks = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f")) != -1) {
+        switch (opt) {
+        case 'f': with_forks = 1; break;
+        default:
+            fprintf(stderr, "Usage: %s [-f] trace.*.bin > trace.json\n"
+                    "  -f  include fork events\n", argv[0]);
+            exit(EX_USAGE);
+        }
+    }
+
+    int n_files = argc - optind;
+    if (n_files <= 0) {
+        fprintf(stderr, "Usage: %s [-f] trace.*.bin > trace.json\n",
+                argv[0]);
+        exit(EX_USAGE);
+    }
+
+    struct trace_file *files = malloc(sizeof(struct trace_file) * n_files);
+
+    /* align the processes by the wall clock time of their start */
+    int64_t base_ns = 0;
+    int i;
+    for (i = 0; i < n_files; i++) {
+        if (!read_trace(argv[optind + i], &files[i]))
+            exit(EX_DATAERR);
+
+        if (i == 0 || files[i].h.start_ns < base_ns)
+            base_ns = files[i].h.start_ns;
+    }
+
+    printf("{\"traceEvents\": [");
+    for (i = 0; i < n_files; i++) {
+        convert(&files[i], base_ns, with_forks);
+        free(files[i].events);
+    }
+    printf("\n]}\n");
+
+    free(files);
+    return 0;
+}